@@ -0,0 +1,120 @@
+#include "benchmark/benchmark.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "big_integer.h"
+
+namespace {
+// operands from 1 to about 10^6 limbs
+const int64_t MIN_LIMBS = 1;
+const int64_t MAX_LIMBS = 1 << 20;
+
+big_integer random_operand(size_t limbs, bool negative, uint64_t seed) {
+  std::mt19937_64 gen(seed);
+  std::vector<big_integer::limb_t> arr(limbs);
+  for (auto& limb : arr) {
+    limb = static_cast<big_integer::limb_t>(gen());
+  }
+  // the top limb is nonzero, so the operand has exactly limbs limbs
+  arr.back() |= 1;
+  return big_integer(arr.data(), arr.data() + arr.size(), negative);
+}
+
+// throughput is reported in limbs per second, counted on the operand the
+// first argument sizes
+void set_throughput(benchmark::State& state) {
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// the first argument is the operand length, the second one makes the second
+// operand of binary operations and the only one of unary ones negative
+void operand_sizes(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"limbs", "negative"});
+  b->ArgsProduct({benchmark::CreateRange(MIN_LIMBS, MAX_LIMBS, 8), {0, 1}});
+  b->Unit(benchmark::kMicrosecond);
+}
+
+void BM_add(benchmark::State& state) {
+  big_integer a = random_operand(state.range(0), false, 1);
+  big_integer b = random_operand(state.range(0), state.range(1) != 0, 2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a + b);
+  }
+  set_throughput(state);
+}
+BENCHMARK(BM_add)->Apply(operand_sizes);
+
+void BM_sub(benchmark::State& state) {
+  big_integer a = random_operand(state.range(0), false, 3);
+  big_integer b = random_operand(state.range(0), state.range(1) != 0, 4);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a - b);
+  }
+  set_throughput(state);
+}
+BENCHMARK(BM_sub)->Apply(operand_sizes);
+
+void BM_mul(benchmark::State& state) {
+  big_integer a = random_operand(state.range(0), false, 5);
+  big_integer b = random_operand(state.range(0), state.range(1) != 0, 6);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a * b);
+  }
+  set_throughput(state);
+}
+BENCHMARK(BM_mul)->Apply(operand_sizes);
+
+// a dividend of twice the length of the divisor
+void BM_div(benchmark::State& state) {
+  big_integer a = random_operand(2 * state.range(0), false, 7);
+  big_integer b = random_operand(state.range(0), state.range(1) != 0, 8);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a / b);
+  }
+  set_throughput(state);
+}
+BENCHMARK(BM_div)->Apply(operand_sizes);
+
+void BM_mod(benchmark::State& state) {
+  big_integer a = random_operand(2 * state.range(0), false, 9);
+  big_integer b = random_operand(state.range(0), state.range(1) != 0, 10);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a % b);
+  }
+  set_throughput(state);
+}
+BENCHMARK(BM_mod)->Apply(operand_sizes);
+
+// a shift that is no multiple of the limb width, left and back right
+void BM_shift(benchmark::State& state) {
+  big_integer a = random_operand(state.range(0), state.range(1) != 0, 11);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize((a << 37) >> 37);
+  }
+  set_throughput(state);
+}
+BENCHMARK(BM_shift)->Apply(operand_sizes);
+
+void BM_to_string(benchmark::State& state) {
+  big_integer a = random_operand(state.range(0), state.range(1) != 0, 12);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(to_string(a));
+  }
+  set_throughput(state);
+}
+BENCHMARK(BM_to_string)->Apply(operand_sizes);
+
+void BM_parse(benchmark::State& state) {
+  std::string str =
+      to_string(random_operand(state.range(0), state.range(1) != 0, 13));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(big_integer(str));
+  }
+  set_throughput(state);
+}
+BENCHMARK(BM_parse)->Apply(operand_sizes);
+} // namespace
+
+BENCHMARK_MAIN();
@@ -1,378 +1,2871 @@
 #include "big_integer.h"
 #include <algorithm>
 #include <cmath>
+#include <condition_variable>
 #include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <istream>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <random>
 #include <stdexcept>
+#include <thread>
+#include <utility>
+
+static const char DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+big_integer_thresholds big_integer::thresholds;
+
+namespace {
+using limb_t = big_integer::limb_t;
+#if BIG_INTEGER_LIMB_BITS == 64
+__extension__ typedef unsigned __int128 double_limb_t;
+#else
+using double_limb_t = uint64_t;
+#endif
+const int LIMB_BITS = big_integer::LIMB_BITS;
+
+using limbs = std::vector<limb_t>;
+
+// Scratch space for the temporaries of the internal algorithms, a stack per
+// thread and element type. The storage outlives the buffers: once the stack
+// is empty again it is merged into one block of the peak size, so loops over
+// operands of a steady size stop allocating.
+template <typename T>
+class scratch_arena {
+public:
+  T* take(size_t n) {
+    if (blocks.empty() || blocks.back().used + n > blocks.back().size) {
+      size_t size = blocks.empty() ? n : std::max(n, 2 * blocks.back().size);
+      blocks.push_back({std::unique_ptr<T[]>(new T[size]), size, 0});
+    }
+    block& b = blocks.back();
+    T* res = b.data.get() + b.used;
+    b.used += n;
+    in_use += n;
+    peak = std::max(peak, in_use);
+    return res;
+  }
 
-static const uint32_t POW_10_BLOCK = 1'000'000'000;
-static const uint32_t POW_10_BLOCK_SIZE = 9;
+  // n has to match the latest buffer not yet given back
+  void give_back(size_t n) {
+    blocks.back().used -= n;
+    in_use -= n;
+    if (blocks.back().used == 0 && blocks.size() > 1) {
+      blocks.pop_back();
+    }
+    if (in_use == 0 && (blocks.size() > 1 || blocks.back().size < peak)) {
+      blocks.clear();
+      blocks.push_back({std::unique_ptr<T[]>(new T[peak]), peak, 0});
+    }
+  }
 
-big_integer::big_integer() = default;
+  void release() {
+    if (in_use == 0) {
+      blocks.clear();
+      peak = 0;
+    }
+  }
 
-big_integer::big_integer(big_integer const& other) = default;
+private:
+  struct block {
+    std::unique_ptr<T[]> data;
+    size_t size;
+    size_t used;
+  };
+
+  std::vector<block> blocks;
+  size_t in_use{0};
+  size_t peak{0};
+};
+
+template <typename T>
+scratch_arena<T>& thread_arena() {
+  thread_local scratch_arena<T> arena;
+  return arena;
+}
 
-big_integer::big_integer(int a) : is_neg(a < 0) {
-  init_big(static_cast<unsigned long long>(a));
+// an uninitialized buffer from the arena for the enclosing scope
+template <typename T>
+class scratch_buffer {
+public:
+  explicit scratch_buffer(size_t n)
+      : arena(thread_arena<T>()), ptr(arena.take(n)), n(n) {}
+  scratch_buffer(scratch_buffer const&) = delete;
+  scratch_buffer& operator=(scratch_buffer const&) = delete;
+  ~scratch_buffer() {
+    arena.give_back(n);
+  }
+
+  T* data() const {
+    return ptr;
+  }
+
+private:
+  scratch_arena<T>& arena;
+  T* ptr;
+  size_t n;
+};
+
+using scratch_limbs = scratch_buffer<limb_t>;
+// the number theoretic transforms work on 32-bit digits
+using scratch_digits = scratch_buffer<uint32_t>;
+
+size_t trimmed_size(limb_t const* a, size_t n) {
+  while (n > 0 && a[n - 1] == 0) {
+    n--;
+  }
+  return n;
 }
 
-big_integer::big_integer(unsigned long long a) {
-  init_big(a);
+// a[0, n) += b[0, m) for n >= m, returns the outgoing carry
+limb_t add_limbs(limb_t* a, size_t n, limb_t const* b, size_t m) {
+  limb_t carry = 0;
+  size_t i = 0;
+  for (; i < m; i++) {
+    double_limb_t res = static_cast<double_limb_t>(a[i]) + b[i] + carry;
+    a[i] = static_cast<limb_t>(res);
+    carry = res >> LIMB_BITS;
+  }
+  for (; carry != 0 && i < n; i++) {
+    a[i]++;
+    carry = (a[i] == 0 ? 1 : 0);
+  }
+  return carry;
 }
 
-big_integer::big_integer(long long a) : is_neg(a < 0) {
-  init_big(static_cast<unsigned long long>(a));
+// a[0, n) -= b[0, m) for n >= m, returns the outgoing borrow
+limb_t sub_limbs(limb_t* a, size_t n, limb_t const* b, size_t m) {
+  limb_t borrow = 0;
+  size_t i = 0;
+  for (; i < m; i++) {
+    double_limb_t res = static_cast<double_limb_t>(a[i]) - b[i] - borrow;
+    a[i] = static_cast<limb_t>(res);
+    borrow = (res >> LIMB_BITS != 0 ? 1 : 0);
+  }
+  for (; borrow != 0 && i < n; i++) {
+    borrow = (a[i] == 0 ? 1 : 0);
+    a[i]--;
+  }
+  return borrow;
 }
 
-big_integer::big_integer(unsigned int a) {
-  init_big(static_cast<unsigned long long>(a));
+// a[0, n) = b[0, n) - a[0, n) for b >= a
+void rsub_limbs(limb_t* a, limb_t const* b, size_t n) {
+  limb_t borrow = 0;
+  for (size_t i = 0; i < n; i++) {
+    double_limb_t res = static_cast<double_limb_t>(b[i]) - a[i] - borrow;
+    a[i] = static_cast<limb_t>(res);
+    borrow = (res >> LIMB_BITS != 0 ? 1 : 0);
+  }
 }
 
-big_integer::big_integer(long a) : is_neg(a < 0) {
-  init_big(static_cast<unsigned long long>(a));
+// a[0, n) = B^n - a[0, n), the two's complement of a nonzero a
+void negate_limbs(limb_t* a, size_t n) {
+  limb_t carry = 1;
+  for (size_t i = 0; i < n; i++) {
+    a[i] = ~a[i] + carry;
+    carry = (carry != 0 && a[i] == 0 ? 1 : 0);
+  }
 }
 
-big_integer::big_integer(unsigned long a) {
-  init_big(static_cast<unsigned long long>(a));
+unsigned long long magnitude(long long a) {
+  return a < 0 ? 0 - static_cast<unsigned long long>(a)
+               : static_cast<unsigned long long>(a);
 }
 
-big_integer::big_integer(std::string const& str) : big_integer() {
-  if (str.empty()) {
-    throw std::invalid_argument("String has to be non-empty");
+// left shift that moves the highest set bit of top to the top of the limb
+int normalization_shift(limb_t top) {
+  int shift = 0;
+  while ((top << shift) >> (LIMB_BITS - 1) == 0) {
+    shift++;
   }
-  uint64_t i = (str[0] == '-' ? 1 : 0);
-  if (str.length() == 1 && i == 1) {
-    throw std::invalid_argument("String cannot be just '-'");
+  return shift;
+}
+
+int cmp_limbs(limb_t const* a, size_t n, limb_t const* b, size_t m) {
+  n = trimmed_size(a, n);
+  m = trimmed_size(b, m);
+  if (n != m) {
+    return n < m ? -1 : 1;
+  }
+  for (size_t i = n; i >= 1; i--) {
+    if (a[i - 1] != b[i - 1]) {
+      return a[i - 1] < b[i - 1] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+// a[0, n) += b[0, n) * c, returns the outgoing carry limb
+limb_t addmul_limbs_1(limb_t* a, limb_t const* b, size_t n, limb_t c) {
+  limb_t carry = 0;
+  for (size_t i = 0; i < n; i++) {
+    double_limb_t mul = static_cast<double_limb_t>(b[i]) * c + carry + a[i];
+    a[i] = static_cast<limb_t>(mul);
+    carry = mul >> LIMB_BITS;
+  }
+  return carry;
+}
+
+// a[0, n) -= b[0, n) * c, returns the outgoing borrow limb
+limb_t submul_limbs_1(limb_t* a, limb_t const* b, size_t n, limb_t c) {
+  limb_t borrow = 0;
+  for (size_t i = 0; i < n; i++) {
+    double_limb_t mul = static_cast<double_limb_t>(b[i]) * c + borrow;
+    auto low = static_cast<limb_t>(mul);
+    borrow = static_cast<limb_t>(mul >> LIMB_BITS) + (a[i] < low ? 1 : 0);
+    a[i] -= low;
   }
-  while (i < str.length()) {
-    int32_t cur_num = 0;
-    uint32_t k = 0;
-    for (; k < POW_10_BLOCK_SIZE; k++) {
-      if (std::isdigit(str[i]) == 0) {
-        throw std::invalid_argument("String has to contain only numbers");
-      }
-      cur_num *= 10;
-      cur_num += str[i] - '0';
-      i++;
-      if (i >= str.length()) {
+  return borrow;
+}
+
+// res[0, n + 1) = a[0, n) << shift for 0 <= shift < LIMB_BITS, res may be a
+void shl_limbs(limb_t* res, limb_t const* a, size_t n, int shift) {
+  limb_t carry = 0;
+  for (size_t i = 0; i < n; i++) {
+    limb_t cur = a[i];
+    res[i] = (cur << shift) | carry;
+    carry = shift == 0 ? 0 : cur >> (LIMB_BITS - shift);
+  }
+  res[n] = carry;
+}
+
+// res[0, n) = a[0, n) >> shift for 0 <= shift < LIMB_BITS, res may be a
+void shr_limbs(limb_t* res, limb_t const* a, size_t n, int shift) {
+  for (size_t i = 0; i < n; i++) {
+    res[i] = a[i] >> shift;
+    if (shift != 0 && i + 1 < n) {
+      res[i] |= a[i + 1] << (LIMB_BITS - shift);
+    }
+  }
+}
+
+// a[0, n) /= d, returns the remainder
+limb_t div_limbs_1(limb_t* a, size_t n, limb_t d) {
+  limb_t rem = 0;
+  for (size_t i = n; i-- > 0;) {
+    double_limb_t cur = (static_cast<double_limb_t>(rem) << LIMB_BITS) | a[i];
+    a[i] = static_cast<limb_t>(cur / d);
+    rem = static_cast<limb_t>(cur % d);
+  }
+  return rem;
+}
+
+// Knuth's algorithm D: q[0, m + 1) = u[0, m + n + 1) / v[0, n), the
+// remainder is left in u[0, n). v has n >= 2 limbs and the highest bit set,
+// u[0, m + n + 1) < v * B^(m + 1).
+void div_limbs(limb_t* q, limb_t* u, size_t m, limb_t const* v, size_t n) {
+  for (size_t j = m + 1; j-- > 0;) {
+    // the estimate from the leading limbs is at most one too large after
+    // the correction against v[n - 2]
+    double_limb_t top =
+        (static_cast<double_limb_t>(u[j + n]) << LIMB_BITS) | u[j + n - 1];
+    double_limb_t q_hat = top / v[n - 1];
+    double_limb_t r_hat = top % v[n - 1];
+    while ((q_hat >> LIMB_BITS) != 0 ||
+           q_hat * v[n - 2] > ((r_hat << LIMB_BITS) | u[j + n - 2])) {
+      q_hat--;
+      r_hat += v[n - 1];
+      if ((r_hat >> LIMB_BITS) != 0) {
         break;
       }
     }
+    limb_t borrow = submul_limbs_1(u + j, v, n, static_cast<limb_t>(q_hat));
+    bool overflow = u[j + n] < borrow;
+    u[j + n] -= borrow;
+    if (overflow) {
+      q_hat--;
+      add_limbs(u + j, n + 1, v, n);
+    }
+    q[j] = static_cast<limb_t>(q_hat);
+  }
+}
+
+void mul_limbs(limb_t* res, limb_t const* a, size_t n, limb_t const* b,
+               size_t m);
+
+// res[0, 2n) = a[0, n)^2: every cross product a[i] * a[j], i < j, is
+// computed once and doubled, then the squares a[i]^2 are added
+void sqr_schoolbook(limb_t* res, limb_t const* a, size_t n) {
+  std::fill(res, res + 2 * n, 0);
+  for (size_t i = 0; i + 1 < n; i++) {
+    res[i + n] = addmul_limbs_1(res + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
+  }
+  limb_t top = 0;
+  for (size_t i = 0; i < 2 * n; i++) {
+    limb_t next = res[i] >> (LIMB_BITS - 1);
+    res[i] = (res[i] << 1) | top;
+    top = next;
+  }
+  limb_t carry = 0;
+  for (size_t i = 0; i < n; i++) {
+    double_limb_t sqr = static_cast<double_limb_t>(a[i]) * a[i];
+    double_limb_t low = static_cast<double_limb_t>(res[2 * i]) +
+                        static_cast<limb_t>(sqr) + carry;
+    res[2 * i] = static_cast<limb_t>(low);
+    double_limb_t high = static_cast<double_limb_t>(res[2 * i + 1]) +
+                         static_cast<limb_t>(sqr >> LIMB_BITS) +
+                         (low >> LIMB_BITS);
+    res[2 * i + 1] = static_cast<limb_t>(high);
+    carry = high >> LIMB_BITS;
+  }
+}
+
+// res[0, n + m) = a[0, n) * b[0, m), res must not overlap the operands;
+// a == b with n == m is a square
+void mul_schoolbook(limb_t* res, limb_t const* a, size_t n,
+                    limb_t const* b, size_t m) {
+  if (a == b && n == m) {
+    sqr_schoolbook(res, a, n);
+    return;
+  }
+  std::fill(res, res + n + m, 0);
+  for (size_t i = 0; i < n; i++) {
+    res[i + m] = addmul_limbs_1(res + i, b, m, a[i]);
+  }
+}
+
+size_t karatsuba_threshold() {
+  return std::max<size_t>(big_integer::thresholds.karatsuba_mul, 4);
+}
+
+size_t karatsuba_scratch_size(size_t n) {
+  size_t res = 0;
+  while (n >= karatsuba_threshold()) {
+    size_t k = (n + 1) / 2;
+    res += 4 * k + 4;
+    n = k + 1;
+  }
+  return res;
+}
+
+// same contract as mul_schoolbook for n >= m, scratch has to hold
+// karatsuba_scratch_size(n) limbs
+void mul_karatsuba(limb_t* res, limb_t const* a, size_t n,
+                   limb_t const* b, size_t m, limb_t* scratch) {
+  if (n < m) {
+    std::swap(a, b);
+    std::swap(n, m);
+  }
+  if (m < karatsuba_threshold()) {
+    mul_schoolbook(res, a, n, b, m);
+    return;
+  }
+  size_t k = (n + 1) / 2;
+  if (m <= k) {
+    // b fits into the lower half of a: a0 * b + (a1 * b) << k
+    limb_t* high = scratch;
+    mul_karatsuba(res, a, k, b, m, scratch);
+    mul_karatsuba(high, a + k, n - k, b, m, scratch + (n - k + m));
+    std::fill(res + k + m, res + n + m, 0);
+    add_limbs(res + k, n + m - k, high, n - k + m);
+    return;
+  }
+  // for a square all three products are squares again
+  bool square = a == b && n == m;
+  size_t n1 = n - k;
+  size_t m1 = m - k;
+  limb_t* sum_a = scratch;
+  limb_t* sum_b = sum_a + (k + 1);
+  limb_t* mid = sum_b + (k + 1);
+  limb_t* next = mid + (2 * k + 2);
+  std::copy(a, a + k, sum_a);
+  sum_a[k] = add_limbs(sum_a, k, a + k, n1);
+  if (square) {
+    sum_b = sum_a;
+  } else {
+    std::copy(b, b + k, sum_b);
+    sum_b[k] = add_limbs(sum_b, k, b + k, m1);
+  }
+
+  mul_karatsuba(res, a, k, b, k, next);
+  mul_karatsuba(res + 2 * k, a + k, n1, b + k, m1, next);
+  mul_karatsuba(mid, sum_a, k + 1, sum_b, k + 1, next);
+  sub_limbs(mid, 2 * k + 2, res, 2 * k);
+  sub_limbs(mid, 2 * k + 2, res + 2 * k, n1 + m1);
+  add_limbs(res + k, n + m - k, mid, trimmed_size(mid, 2 * k + 2));
+}
+
+// Toom-3 intermediate values can be negative; the magnitude lives in scratch
+// limbs with room for every value it takes
+struct signed_limbs {
+  limb_t* mag;
+  size_t size;
+  bool neg;
+};
+
+signed_limbs slice(limb_t* buf, limb_t const* a, size_t n, size_t from,
+                   size_t to) {
+  from = std::min(from, n);
+  to = std::min(to, n);
+  std::copy(a + from, a + to, buf);
+  return {buf, trimmed_size(buf, to - from), false};
+}
+
+void copy_signed(signed_limbs& x, signed_limbs const& y) {
+  std::copy(y.mag, y.mag + y.size, x.mag);
+  x.size = y.size;
+  x.neg = y.neg;
+}
+
+void add_signed(signed_limbs& x, signed_limbs const& y, bool subtract) {
+  bool y_neg = (y.neg != subtract);
+  if (x.neg == y_neg) {
+    size_t len = std::max(x.size, y.size) + 1;
+    std::fill(x.mag + x.size, x.mag + len, 0);
+    add_limbs(x.mag, len, y.mag, y.size);
+    x.size = len;
+  } else if (cmp_limbs(x.mag, x.size, y.mag, y.size) >= 0) {
+    sub_limbs(x.mag, x.size, y.mag, y.size);
+  } else {
+    std::fill(x.mag + x.size, x.mag + y.size, 0);
+    rsub_limbs(x.mag, y.mag, y.size);
+    x.size = y.size;
+    x.neg = y_neg;
+  }
+  x.size = trimmed_size(x.mag, x.size);
+  x.neg = x.neg && x.size != 0;
+}
+
+void mul_signed(signed_limbs& res, signed_limbs const& x,
+                signed_limbs const& y) {
+  mul_limbs(res.mag, x.mag, x.size, y.mag, y.size);
+  res.size = trimmed_size(res.mag, x.size + y.size);
+  res.neg = (x.neg != y.neg) && res.size != 0;
+}
+
+void shl_one(signed_limbs& x) {
+  shl_limbs(x.mag, x.mag, x.size, 1);
+  x.size = trimmed_size(x.mag, x.size + 1);
+}
+
+void div_exact(signed_limbs& x, limb_t num) {
+  div_limbs_1(x.mag, x.size, num);
+  x.size = trimmed_size(x.mag, x.size);
+}
+
+// evaluates x0 + x1 * t + x2 * t^2 at t = 1, -1, -2; for k-limb x0, x1, x2
+// the values fit k + 2 limbs
+void toom3_evaluate(signed_limbs const& x0, signed_limbs const& x1,
+                    signed_limbs const& x2, signed_limbs& at_1,
+                    signed_limbs& at_m1, signed_limbs& at_m2) {
+  copy_signed(at_1, x0);
+  add_signed(at_1, x2, false);
+  copy_signed(at_m1, at_1);
+  add_signed(at_1, x1, false);
+  add_signed(at_m1, x1, true);
+  copy_signed(at_m2, at_m1);
+  add_signed(at_m2, x2, false);
+  shl_one(at_m2);
+  add_signed(at_m2, x0, true);
+}
+
+// Workers for the independent parts of large operations. A caller of run
+// takes part in the work and, while its own tasks are still running
+// elsewhere, executes queued tasks of other callers, so tasks may call run
+// again without a deadlock.
+class thread_pool {
+public:
+  explicit thread_pool(size_t workers) {
+    for (size_t i = 0; i < workers; i++) {
+      threads.emplace_back([this] { work(); });
+    }
+  }
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv.notify_all();
+    for (std::thread& t : threads) {
+      t.join();
+    }
+  }
+
+  size_t workers() const {
+    return threads.size();
+  }
+
+  // returns once every task has finished, rethrows the first exception
+  void run(std::vector<std::function<void()>> const& tasks) {
+    group g{tasks.size(), nullptr};
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (size_t i = 1; i < tasks.size(); i++) {
+        queue.push_back({&tasks[i], &g});
+      }
+    }
+    cv.notify_all();
+    execute({&tasks[0], &g});
+    std::unique_lock<std::mutex> lock(mutex);
+    while (g.pending > 0) {
+      if (queue.empty()) {
+        cv.wait(lock);
+        continue;
+      }
+      job j = queue.front();
+      queue.pop_front();
+      lock.unlock();
+      execute(j);
+      lock.lock();
+    }
+    if (g.error) {
+      std::rethrow_exception(g.error);
+    }
+  }
+
+private:
+  struct group {
+    size_t pending;
+    std::exception_ptr error;
+  };
+
+  struct job {
+    std::function<void()> const* task;
+    group* g;
+  };
+
+  void execute(job j) {
+    std::exception_ptr error;
+    try {
+      (*j.task)();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (error && !j.g->error) {
+        j.g->error = error;
+      }
+      j.g->pending--;
+    }
+    cv.notify_all();
+  }
+
+  void work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [this] { return stop || !queue.empty(); });
+      if (queue.empty()) {
+        return;
+      }
+      job j = queue.front();
+      queue.pop_front();
+      lock.unlock();
+      execute(j);
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<job> queue;
+  bool stop{false};
+  std::vector<std::thread> threads;
+};
+
+std::mutex pool_mutex;
+// threads including the caller, 0 until configured
+size_t pool_threads = 0;
+std::shared_ptr<thread_pool> pool;
+
+size_t default_threads() {
+  return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+// runs task(0), ..., task(count - 1) on the pool, or one after another
+// without allocating when it has no workers; only reached above the size
+// thresholds, smaller operations never lock
+template <typename F>
+void run_parallel(size_t count, F const& task) {
+  std::shared_ptr<thread_pool> p;
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!pool) {
+      size_t n = pool_threads == 0 ? default_threads() : pool_threads;
+      pool = std::make_shared<thread_pool>(n - 1);
+    }
+    p = pool;
+  }
+  if (p->workers() == 0) {
+    for (size_t i = 0; i < count; i++) {
+      task(i);
+    }
+    return;
+  }
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < count; i++) {
+    tasks.emplace_back([&task, i] { task(i); });
+  }
+  p->run(tasks);
+}
+
+// same contract as mul_schoolbook for m <= n < 2 * m; the parts, their
+// values and the five products live in one scratch buffer, the products are
+// computed in the scratch of the threads that run them
+void mul_toom3(limb_t* res, limb_t const* a, size_t n, limb_t const* b,
+               size_t m) {
+  size_t k = (n + 2) / 3;
+  scratch_limbs buf(2 * (3 * k + 3 * (k + 2)) + 5 * (2 * k + 2));
+  limb_t* next = buf.data();
+  auto take = [&next](size_t len) {
+    signed_limbs res{next, 0, false};
+    next += len;
+    return res;
+  };
+  signed_limbs a0 = slice(take(k).mag, a, n, 0, k);
+  signed_limbs a1 = slice(take(k).mag, a, n, k, 2 * k);
+  signed_limbs a2 = slice(take(k).mag, a, n, 2 * k, n);
+  signed_limbs a_1 = take(k + 2);
+  signed_limbs a_m1 = take(k + 2);
+  signed_limbs a_m2 = take(k + 2);
+  toom3_evaluate(a0, a1, a2, a_1, a_m1, a_m2);
+  // a square needs one evaluation, the five products are squares again
+  bool square = a == b && n == m;
+  signed_limbs b0 = slice(take(k).mag, b, m, 0, k);
+  signed_limbs b1 = slice(take(k).mag, b, m, k, 2 * k);
+  signed_limbs b2 = slice(take(k).mag, b, m, 2 * k, m);
+  signed_limbs b_1 = take(k + 2);
+  signed_limbs b_m1 = take(k + 2);
+  signed_limbs b_m2 = take(k + 2);
+  if (!square) {
+    toom3_evaluate(b0, b1, b2, b_1, b_m1, b_m2);
+  }
+
+  signed_limbs const* lhs[] = {&a0, &a_1, &a_m1, &a_m2, &a2};
+  signed_limbs const* rhs[] = {&b0, &b_1, &b_m1, &b_m2, &b2};
+  signed_limbs r[5];
+  for (signed_limbs& x : r) {
+    x = take(2 * k + 2);
+  }
+  auto product = [&](size_t i) {
+    mul_signed(r[i], *lhs[i], square ? *lhs[i] : *rhs[i]);
+  };
+  if (m >= big_integer::thresholds.parallel_mul) {
+    run_parallel(5, product);
+  } else {
+    for (size_t i = 0; i < 5; i++) {
+      product(i);
+    }
+  }
+  signed_limbs& r0 = r[0];
+  signed_limbs& r1 = r[1];
+  signed_limbs& r2 = r[2];
+  signed_limbs& r3 = r[3];
+  signed_limbs& r4 = r[4];
+
+  // Bodrato's interpolation sequence
+  add_signed(r3, r1, true);
+  div_exact(r3, 3);
+  add_signed(r1, r2, true);
+  div_exact(r1, 2);
+  add_signed(r2, r0, true);
+  r3.neg = !r3.neg && r3.size != 0;
+  add_signed(r3, r2, false);
+  div_exact(r3, 2);
+  add_signed(r3, r4, false);
+  add_signed(r3, r4, false);
+  add_signed(r2, r1, false);
+  add_signed(r2, r4, true);
+  add_signed(r1, r3, true);
+
+  std::fill(res, res + n + m, 0);
+  for (size_t i = 0; i < 5; i++) {
+    add_limbs(res + i * k, n + m - i * k, r[i].mag, r[i].size);
+  }
+}
+
+uint64_t pow_mod(uint64_t base, uint64_t exp, uint64_t mod) {
+  uint64_t res = 1;
+  base %= mod;
+  while (exp > 0) {
+    if (exp & 1) {
+      res = res * base % mod;
+    }
+    base = base * base % mod;
+    exp >>= 1;
+  }
+  return res;
+}
+
+// Arithmetic in Montgomery form modulo a prime p < 2^31 with p - 1 divisible
+// by a large power of two
+struct ntt_prime {
+  uint32_t mod;
+  uint32_t root;
+  uint32_t neg_inv;
+  uint32_t r2;
+
+  ntt_prime(uint32_t mod, uint32_t root)
+      : mod(mod), root(root), neg_inv(mod),
+        r2(static_cast<uint32_t>(
+            (std::numeric_limits<uint64_t>::max() % mod + 1) % mod)) {
+    for (size_t i = 0; i < 4; i++) {
+      neg_inv *= 2 - mod * neg_inv;
+    }
+    neg_inv = 0 - neg_inv;
+  }
+
+  // x * 2^-32 mod p for x < p * 2^32
+  uint32_t reduce(uint64_t x) const {
+    uint32_t k = static_cast<uint32_t>(x) * neg_inv;
+    auto res = static_cast<uint32_t>((x + static_cast<uint64_t>(k) * mod) >> 32);
+    return normalize(res - mod);
+  }
+
+  uint32_t mul(uint32_t a, uint32_t b) const {
+    return reduce(static_cast<uint64_t>(a) * b);
+  }
+
+  // maps x in [-p, p) (as a wrapped uint32_t) to [0, p) without branching
+  uint32_t normalize(uint32_t x) const {
+    return x + (mod & (0 - (x >> 31)));
+  }
+
+  uint32_t add(uint32_t a, uint32_t b) const {
+    return normalize(a + b - mod);
+  }
+
+  uint32_t sub(uint32_t a, uint32_t b) const {
+    return normalize(a - b);
+  }
+
+  uint32_t to_mont(uint32_t a) const {
+    return mul(a, r2);
+  }
+
+  uint32_t pow(uint32_t base, uint64_t exp) const {
+    uint32_t res = to_mont(1);
+    while (exp > 0) {
+      if (exp & 1) {
+        res = mul(res, base);
+      }
+      base = mul(base, base);
+      exp >>= 1;
+    }
+    return res;
+  }
+
+  // roots[half + j] = w_len^j for every power of two len <= n, half = len / 2
+  void root_table(uint32_t* roots, size_t n) const {
+    for (size_t half = 1; half < n; half <<= 1) {
+      uint32_t w = pow(to_mont(root), (mod - 1) / (2 * half));
+      roots[half] = to_mont(1);
+      for (size_t j = 1; j < half; j++) {
+        roots[half + j] = mul(roots[half + j - 1], w);
+      }
+    }
+  }
 
-    if (k == POW_10_BLOCK_SIZE) {
-      small_mul(POW_10_BLOCK);
+  // in-place iterative radix-2 transform, n has to be a power of two; the
+  // inverse transform is the forward one with reversed output
+  void transform(uint32_t* a, size_t n, uint32_t const* roots,
+                 bool invert) const {
+    for (size_t i = 1, j = 0; i < n; i++) {
+      size_t bit = n >> 1;
+      for (; j & bit; bit >>= 1) {
+        j ^= bit;
+      }
+      j ^= bit;
+      if (i < j) {
+        std::swap(a[i], a[j]);
+      }
+    }
+    for (size_t half = 1; half < n; half <<= 1) {
+      uint32_t const* w = roots + half;
+      for (size_t i = 0; i < n; i += 2 * half) {
+        uint32_t* lo = a + i;
+        uint32_t* hi = lo + half;
+        for (size_t j = 0; j < half; j++) {
+          uint32_t u = lo[j];
+          uint32_t v = mul(hi[j], w[j]);
+          lo[j] = add(u, v);
+          hi[j] = sub(u, v);
+        }
+      }
+    }
+    if (invert) {
+      std::reverse(a + 1, a + n);
+      uint32_t n_inv = pow(to_mont(static_cast<uint32_t>(n % mod)), mod - 2);
+      for (size_t i = 0; i < n; i++) {
+        a[i] = mul(a[i], n_inv);
+      }
+    }
+  }
+};
+
+// all three primes admit transforms of length up to 2^24, their product
+// exceeds 2^88 > 2^24 * (2^32)^2, so every convolution coefficient is
+// recovered exactly
+const size_t NTT_MAX_SIZE = size_t(1) << 24;
+
+void mul_ntt_digits(uint32_t* res, uint32_t const* a, size_t n,
+                    uint32_t const* b, size_t m) {
+  static const ntt_prime primes[3] = {
+      {2013265921, 31}, {469762049, 3}, {754974721, 11}};
+  size_t len = 1;
+  while (len < n + m - 1) {
+    len <<= 1;
+  }
+  // a square needs two transforms per prime instead of three
+  bool square = a == b && n == m;
+  // the three primes are independent and may run on separate threads; the
+  // residues stay in the scratch of the caller, the transforms of each prime
+  // work in the scratch of the thread that runs it
+  scratch_digits residues(3 * len);
+  run_parallel(3, [&](size_t p) {
+    ntt_prime const& f = primes[p];
+    scratch_digits roots(len);
+    f.root_table(roots.data(), len);
+    uint32_t* fa = residues.data() + p * len;
+    for (size_t i = 0; i < n; i++) {
+      fa[i] = f.to_mont(a[i]);
+    }
+    std::fill(fa + n, fa + len, 0);
+    f.transform(fa, len, roots.data(), false);
+    if (square) {
+      for (size_t i = 0; i < len; i++) {
+        fa[i] = f.mul(fa[i], fa[i]);
+      }
     } else {
-      uint32_t pow = 10;
-      for (; k > 0; k--) {
-        pow *= 10;
+      scratch_digits fb(len);
+      for (size_t i = 0; i < m; i++) {
+        fb.data()[i] = f.to_mont(b[i]);
+      }
+      std::fill(fb.data() + m, fb.data() + len, 0);
+      f.transform(fb.data(), len, roots.data(), false);
+      for (size_t i = 0; i < len; i++) {
+        fa[i] = f.mul(fa[i], fb.data()[i]);
       }
-      small_mul(pow);
     }
-    add_int(cur_num);
+    f.transform(fa, len, roots.data(), true);
+    for (size_t i = 0; i < n + m - 1; i++) {
+      fa[i] = f.reduce(fa[i]);
+    }
+  });
+  uint32_t const* residue[] = {residues.data(), residues.data() + len,
+                               residues.data() + 2 * len};
+
+  // Garner's recombination: x = v1 + p1 * v2 + p1 * p2 * v3
+  uint64_t p1 = primes[0].mod;
+  uint64_t p2 = primes[1].mod;
+  uint64_t p3 = primes[2].mod;
+  uint64_t inv_p1_p2 = pow_mod(p1, p2 - 2, p2);
+  uint64_t inv_p1_p3 = pow_mod(p1, p3 - 2, p3);
+  uint64_t inv_p2_p3 = pow_mod(p2, p3 - 2, p3);
+  uint64_t p12 = p1 * p2;
+  uint32_t carry[3] = {0, 0, 0};
+  for (size_t i = 0; i < n + m; i++) {
+    uint32_t digit[3] = {0, 0, 0};
+    if (i + 1 < n + m) {
+      uint64_t v1 = residue[0][i];
+      uint64_t v2 = (residue[1][i] + p2 - v1 % p2) % p2 * inv_p1_p2 % p2;
+      uint64_t v3 = (residue[2][i] + p3 - v1 % p3) % p3 * inv_p1_p3 % p3;
+      v3 = (v3 + p3 - v2 % p3) % p3 * inv_p2_p3 % p3;
+      uint64_t low = v1 + p1 * v2;
+      uint64_t mid = v3 * static_cast<uint32_t>(p12);
+      uint64_t high = v3 * (p12 >> 32);
+      uint64_t sum = (low & 0xFFFFFFFF) + (mid & 0xFFFFFFFF);
+      digit[0] = static_cast<uint32_t>(sum);
+      sum = (sum >> 32) + (low >> 32) + (mid >> 32) + (high & 0xFFFFFFFF);
+      digit[1] = static_cast<uint32_t>(sum);
+      digit[2] = static_cast<uint32_t>((sum >> 32) + (high >> 32));
+    }
+    uint64_t sum = static_cast<uint64_t>(carry[0]) + digit[0];
+    res[i] = static_cast<uint32_t>(sum);
+    sum = (sum >> 32) + carry[1] + digit[1];
+    carry[0] = static_cast<uint32_t>(sum);
+    sum = (sum >> 32) + carry[2] + digit[2];
+    carry[1] = static_cast<uint32_t>(sum);
+    carry[2] = static_cast<uint32_t>(sum >> 32);
   }
-  if (str[0] == '-') {
-    negate();
+}
+
+// the transforms work on 32-bit digits, wider limbs are split up
+void mul_ntt(limb_t* res, limb_t const* a, size_t n, limb_t const* b,
+             size_t m) {
+  const size_t ratio = LIMB_BITS / 32;
+  bool square = a == b && n == m;
+  scratch_digits da(n * ratio);
+  scratch_digits db(square ? 0 : m * ratio);
+  scratch_digits dr((n + m) * ratio);
+  for (size_t i = 0; i < n * ratio; i++) {
+    da.data()[i] = static_cast<uint32_t>(a[i / ratio] >> (32 * (i % ratio)));
+  }
+  for (size_t i = 0; !square && i < m * ratio; i++) {
+    db.data()[i] = static_cast<uint32_t>(b[i / ratio] >> (32 * (i % ratio)));
+  }
+  mul_ntt_digits(dr.data(), da.data(), n * ratio,
+                 square ? da.data() : db.data(), m * ratio);
+  std::fill(res, res + n + m, 0);
+  for (size_t i = 0; i < (n + m) * ratio; i++) {
+    res[i / ratio] |= static_cast<limb_t>(dr.data()[i]) << (32 * (i % ratio));
   }
 }
 
-big_integer::~big_integer() = default;
+void mul_unbalanced(limb_t* res, limb_t const* a, size_t n,
+                    limb_t const* b, size_t m) {
+  std::fill(res, res + n + m, 0);
+  scratch_limbs chunk(2 * m);
+  for (size_t i = 0; i < n; i += m) {
+    size_t len = std::min(m, n - i);
+    mul_limbs(chunk.data(), a + i, len, b, m);
+    add_limbs(res + i, n + m - i, chunk.data(), len + m);
+  }
+}
 
-void big_integer::resize(size_t new_size, uint32_t val) {
-  if (new_size <= arr.size()) {
+// res[0, n + m) = a[0, n) * b[0, m), picks the algorithm by operand sizes;
+// passing the same pointer and length twice selects the squaring variants
+void mul_limbs(limb_t* res, limb_t const* a, size_t n, limb_t const* b,
+               size_t m) {
+  if (n < m) {
+    std::swap(a, b);
+    std::swap(n, m);
+  }
+  if (m < karatsuba_threshold()) {
+    mul_schoolbook(res, a, n, b, m);
+  } else if (n >= 2 * m) {
+    mul_unbalanced(res, a, n, b, m);
+  } else if (m < big_integer::thresholds.toom3_mul) {
+    scratch_limbs scratch(karatsuba_scratch_size(n));
+    mul_karatsuba(res, a, n, b, m, scratch.data());
+  } else if (m >= big_integer::thresholds.ntt_mul &&
+             (n + m) * (LIMB_BITS / 32) - 1 <= NTT_MAX_SIZE) {
+    mul_ntt(res, a, n, b, m);
+  } else {
+    mul_toom3(res, a, n, b, m);
+  }
+}
+
+// inv[0, m + 1) = floor(B^2m / d[0, m)) for d with the highest bit set,
+// B = 2^LIMB_BITS; refined by Newton iteration from the reciprocal of the
+// upper half of d
+void reciprocal_limbs(limb_t* inv, limb_t const* d, size_t m) {
+  if (m < std::max<size_t>(big_integer::thresholds.newton_div, 2)) {
+    scratch_limbs u(2 * m + 1);
+    std::fill(u.data(), u.data() + 2 * m, 0);
+    u.data()[2 * m] = 1;
+    if (m == 1) {
+      div_limbs_1(u.data(), 3, d[0]);
+      std::copy(u.data(), u.data() + 2, inv);
+    } else {
+      div_limbs(inv, u.data(), m, d, m);
+    }
     return;
   }
-  arr.resize(new_size, val);
+  size_t h = (m + 1) / 2;
+  std::fill(inv, inv + (m - h), 0);
+  reciprocal_limbs(inv + (m - h), d + (m - h), h);
+  scratch_limbs buf(2 * (2 * m + 1) + (3 * m + 2));
+  limb_t* pow_b = buf.data();
+  limb_t* err = pow_b + 2 * m + 1;
+  limb_t* t = err + 2 * m + 1;
+  std::fill(pow_b, pow_b + 2 * m, 0);
+  pow_b[2 * m] = 1;
+  limb_t one = 1;
+
+  // x += x (B^2m - d x) / B^2m rounded down, the error may be negative
+  mul_limbs(err, d, m, inv, m + 1);
+  bool neg = cmp_limbs(err, 2 * m + 1, pow_b, 2 * m + 1) > 0;
+  if (neg) {
+    sub_limbs(err, 2 * m + 1, pow_b, 2 * m + 1);
+  } else {
+    rsub_limbs(err, pow_b, 2 * m + 1);
+  }
+  size_t e = trimmed_size(err, 2 * m + 1);
+  if (e > 0) {
+    size_t t_len = m + 1 + e;
+    mul_limbs(t, inv, m + 1, err, e);
+    size_t c = t_len > 2 * m ? trimmed_size(t + 2 * m, t_len - 2 * m) : 0;
+    if (neg) {
+      sub_limbs(inv, m + 1, t + 2 * m, c);
+      if (trimmed_size(t, std::min(t_len, 2 * m)) != 0) {
+        sub_limbs(inv, m + 1, &one, 1);
+      }
+    } else {
+      add_limbs(inv, m + 1, t + 2 * m, c);
+    }
+  }
+
+  // a few units off at most
+  mul_limbs(err, d, m, inv, m + 1);
+  while (cmp_limbs(err, 2 * m + 1, pow_b, 2 * m + 1) > 0) {
+    sub_limbs(inv, m + 1, &one, 1);
+    sub_limbs(err, 2 * m + 1, d, m);
+  }
+  rsub_limbs(err, pow_b, 2 * m + 1);
+  while (cmp_limbs(err, 2 * m + 1, d, m) >= 0) {
+    add_limbs(inv, m + 1, &one, 1);
+    sub_limbs(err, 2 * m + 1, d, m);
+  }
 }
 
-big_integer& big_integer::operator=(big_integer const& other) {
-  if (this == &other) {
-    return *this;
+// q[0, blocks * m) = u[0, len) / d[0, m) for blocks = ceil(len / m), the
+// remainder is left in u[0, m) and the limbs above are cleared; d has the
+// highest bit set and inv[0, m + 1) is its reciprocal. The dividend is
+// consumed in m-limb blocks, each one costing two m-by-m multiplications.
+void barrett_limbs(limb_t* q, limb_t* u, size_t len, limb_t const* d,
+                   size_t m, limb_t const* inv) {
+  size_t blocks = (len + m - 1) / m;
+  scratch_limbs buf((2 * m + 2) + 2 * m);
+  limb_t* prod = buf.data();
+  limb_t* dq = prod + 2 * m + 2;
+  limb_t one = 1;
+  for (size_t i = blocks; i-- > 0;) {
+    // the remainder so far followed by the next block, below d * B^m
+    limb_t* w = u + i * m;
+    size_t w_len = std::min(2 * m, len - i * m);
+    limb_t* q_block = q + i * m;
+    std::fill(q_block, q_block + m, 0);
+    // the estimate from the top m + 1 limbs is a few units low at most
+    if (w_len >= m) {
+      size_t top = w_len - (m - 1);
+      mul_limbs(prod, w + (m - 1), top, inv, m + 1);
+      size_t q_len = trimmed_size(prod + (m + 1), top);
+      std::copy(prod + (m + 1), prod + (m + 1) + q_len, q_block);
+      if (q_len > 0) {
+        mul_limbs(dq, d, m, q_block, q_len);
+        sub_limbs(w, w_len, dq, trimmed_size(dq, m + q_len));
+      }
+    }
+    while (cmp_limbs(w, w_len, d, m) >= 0) {
+      sub_limbs(w, w_len, d, m);
+      add_limbs(q_block, m, &one, 1);
+    }
   }
-  big_integer copy = big_integer(other);
-  swap(copy, *this);
-  return *this;
 }
 
-uint32_t big_integer::get_complement() const {
-  return (is_neg ? std::numeric_limits<uint32_t>::max() : 0);
+// limbs of the quotient div_normalized writes, with or without a reciprocal
+size_t quotient_size(size_t m, size_t n, bool reciprocal) {
+  return reciprocal && m >= n ? (m + 2 * n) / n * n : m + 1;
 }
 
-big_integer& big_integer::remove_leading() {
-  uint32_t to_remove = get_complement();
-  while (!arr.empty() && arr.back() == to_remove) {
-    arr.pop_back();
+// q = u[0, m + n + 1) / d[0, n) with the remainder left in u[0, n); d has
+// n >= 2 limbs and the highest bit set. Given the reciprocal inv[0, n + 1),
+// quotients about as long as d go through Barrett division.
+void div_normalized(limb_t* q, limb_t* u, size_t m, limb_t const* d, size_t n,
+                    limb_t const* inv) {
+  if (inv != nullptr && m >= n) {
+    barrett_limbs(q, u, m + n + 1, d, n, inv);
+  } else {
+    div_limbs(q, u, m, d, n);
+  }
+}
+
+// res[0, n) = t * B^-n mod m for t[0, 2n + 1) < m * B^n, t is clobbered;
+// step i adds the multiple of m that clears limb i of t
+void redc(limb_t* res, limb_t* t, limb_t const* m, size_t n,
+          limb_t neg_inv) {
+  t[2 * n] = 0;
+  for (size_t i = 0; i < n; i++) {
+    limb_t carry = addmul_limbs_1(t + i, m, n, t[i] * neg_inv);
+    add_limbs(t + i + n, n + 1 - i, &carry, 1);
   }
-  if (arr.empty() && (to_remove > 0)) {
-    arr.push_back(to_remove);
+  if (t[2 * n] != 0 || cmp_limbs(t + n, n, m, n) >= 0) {
+    sub_limbs(t + n, n + 1, m, n);
   }
-  return *this;
+  std::copy(t + n, t + 2 * n, res);
 }
 
-big_integer& big_integer::operator+=(big_integer const& rhs) {
-  add_with_func([](uint32_t num) { return num; }, rhs, 0);
-  return *this;
+// res = a * b * B^-n mod m for n-limb a, b < m; t holds 2n + 1 limbs,
+// res may alias the operands
+void mont_mul(limb_t* res, limb_t const* a, limb_t const* b, limb_t const* m,
+              size_t n, limb_t neg_inv, limb_t* t) {
+  mul_limbs(t, a, n, b, n);
+  redc(res, t, m, n, neg_inv);
+}
+
+// res[0, n) = (-1)^neg a[0, len) mod m[0, n) in [0, m), for m with n limbs
+void reduce_limbs(limb_t* res, limb_t const* a, size_t len, bool neg,
+                  limb_t const* m, size_t n) {
+  std::fill(res, res + n, 0);
+  if (cmp_limbs(a, len, m, n) < 0) {
+    std::copy(a, a + trimmed_size(a, len), res);
+  } else if (n == 1) {
+    scratch_limbs u(len);
+    std::copy(a, a + len, u.data());
+    res[0] = div_limbs_1(u.data(), len, m[0]);
+  } else {
+    int shift = normalization_shift(m[n - 1]);
+    scratch_limbs buf((n + 1) + (len + 1) + (len - n + 1));
+    limb_t* v = buf.data();
+    limb_t* u = v + n + 1;
+    limb_t* q = u + len + 1;
+    shl_limbs(v, m, n, shift);
+    shl_limbs(u, a, len, shift);
+    div_limbs(q, u, len - n, v, n);
+    shr_limbs(res, u, n, shift);
+  }
+  if (neg && trimmed_size(res, n) != 0) {
+    rsub_limbs(res, m, n);
+  }
+}
+
+// bits of the exponent covered by one table lookup
+int window_bits(size_t exp_bits) {
+  static size_t const limits[] = {7, 25, 81, 241, 673};
+  int k = 1;
+  for (size_t limit : limits) {
+    k += (exp_bits > limit ? 1 : 0);
+  }
+  return k;
+}
+
+// floor(a[0, n) / 2^shift) for a result below 2^(2 * LIMB_BITS)
+double_limb_t top_bits(limb_t const* a, size_t n, size_t shift) {
+  auto limb = [a, n](size_t i) { return i < n ? a[i] : 0; };
+  size_t i = shift / LIMB_BITS;
+  int r = shift % LIMB_BITS;
+  double_limb_t low = (static_cast<double_limb_t>(limb(i + 1)) << LIMB_BITS) |
+                      limb(i);
+  if (r == 0) {
+    return low;
+  }
+  return (low >> r) |
+         (static_cast<double_limb_t>(limb(i + 2)) << (2 * LIMB_BITS - r));
+}
+
+// Magnitudes of the cofactors of a run of Euclid steps: the steps map (x, y)
+// to (a x - b y, d y - c x), or to the negation of that after an odd number
+// of steps.
+struct lehmer_cofactors {
+  limb_t a{1};
+  limb_t b{0};
+  limb_t c{0};
+  limb_t d{1};
+  bool odd{false};
+};
+
+// Knuth's algorithm L on the leading bits x >= y of two numbers: a quotient
+// is taken only if both ends of its possible range agree, so the steps are
+// the ones Euclid would take on the full numbers. Cofactors stay below B.
+lehmer_cofactors lehmer_simulate(double_limb_t x, double_limb_t y) {
+  lehmer_cofactors f;
+  while (true) {
+    double_limb_t num1, den1, num2, den2;
+    if (!f.odd) {
+      if (y <= f.c || x < f.b) {
+        break;
+      }
+      num1 = x + f.a;
+      den1 = y - f.c;
+      num2 = x - f.b;
+      den2 = y + f.d;
+    } else {
+      if (y <= f.d || x < f.a) {
+        break;
+      }
+      num1 = x - f.a;
+      den1 = y + f.c;
+      num2 = x + f.b;
+      den2 = y - f.d;
+    }
+    if (num1 < den1 || num2 < den2) {
+      break;
+    }
+    // quotients are mostly tiny
+    double_limb_t q = num1 - den1 < den1 ? 1 : num1 / den1;
+    double_limb_t q2 = num2 - den2 < den2 ? 1 : num2 / den2;
+    if (q != q2 || q > std::numeric_limits<limb_t>::max()) {
+      break;
+    }
+    double_limb_t c = f.a + q * f.c;
+    double_limb_t d = f.b + q * f.d;
+    if (c > std::numeric_limits<limb_t>::max() ||
+        d > std::numeric_limits<limb_t>::max()) {
+      break;
+    }
+    // x - q y written through the remainder of num1 / den1
+    double_limb_t rem = num1 - q * den1;
+    if (!f.odd && rem < c) {
+      break;
+    }
+    x = y;
+    y = f.odd ? rem + c : rem - c;
+    f.a = f.c;
+    f.b = f.d;
+    f.c = static_cast<limb_t>(c);
+    f.d = static_cast<limb_t>(d);
+    f.odd = !f.odd;
+  }
+  return f;
+}
+
+// next limb of u p - v q, the carries run across calls
+struct mul_sub_carry {
+  limb_t carry{0};
+  limb_t borrow{0};
+
+  limb_t next(limb_t u, limb_t p, limb_t v, limb_t q) {
+    double_limb_t add = static_cast<double_limb_t>(u) * p + carry;
+    double_limb_t sub = static_cast<double_limb_t>(v) * q + borrow;
+    carry = add >> LIMB_BITS;
+    borrow = sub >> LIMB_BITS;
+    auto low = static_cast<limb_t>(add);
+    auto low_sub = static_cast<limb_t>(sub);
+    borrow += (low < low_sub ? 1 : 0);
+    return low - low_sub;
+  }
+};
+
+// next limb of u p + v q, the carries run across calls
+struct mul_add_carry {
+  limb_t carry{0};
+  limb_t carry_v{0};
+
+  limb_t next(limb_t u, limb_t p, limb_t v, limb_t q) {
+    double_limb_t add = static_cast<double_limb_t>(u) * p + carry;
+    double_limb_t add_v = static_cast<double_limb_t>(v) * q + carry_v;
+    carry = add >> LIMB_BITS;
+    carry_v = add_v >> LIMB_BITS;
+    auto low = static_cast<limb_t>(add);
+    auto res = static_cast<limb_t>(low + static_cast<limb_t>(add_v));
+    carry += (res < low ? 1 : 0);
+    return res;
+  }
+};
+
+// applies the steps of f to x[0, n) and y[0, n) in a single pass; both
+// results are Euclid remainders, so they are non-negative and fit n limbs
+void lehmer_update(limb_t* x, limb_t* y, size_t n, lehmer_cofactors const& f) {
+  mul_sub_carry rx;
+  mul_sub_carry ry;
+  for (size_t i = 0; i < n; i++) {
+    limb_t xi = x[i];
+    limb_t yi = y[i];
+    if (!f.odd) {
+      x[i] = rx.next(xi, f.a, yi, f.b);
+      y[i] = ry.next(yi, f.d, xi, f.c);
+    } else {
+      x[i] = rx.next(yi, f.b, xi, f.a);
+      y[i] = ry.next(xi, f.c, yi, f.d);
+    }
+  }
+}
+
+int bit_width(unsigned k) {
+  int res = 0;
+  for (; k != 0; k >>= 1) {
+    res++;
+  }
+  return res;
+}
+
+big_integer power(big_integer const& a, unsigned k) {
+  big_integer res = 1;
+  for (int i = bit_width(k) - 1; i >= 0; i--) {
+    res = sqr(res);
+    if ((k >> i) & 1) {
+      res *= a;
+    }
+  }
+  return res;
+}
+
+// res = base^k, returns its length; res and tmp hold one limb more than the
+// result
+size_t power_limbs(limb_t* res, limb_t* tmp, limb_t base, unsigned k) {
+  limb_t* cur = res;
+  limb_t* other = tmp;
+  cur[0] = 1;
+  size_t len = 1;
+  for (int i = bit_width(k) - 1; i >= 0; i--) {
+    mul_limbs(other, cur, len, cur, len);
+    len = trimmed_size(other, 2 * len);
+    std::swap(cur, other);
+    if ((k >> i) & 1) {
+      mul_limbs(other, cur, len, &base, 1);
+      len = trimmed_size(other, len + 1);
+      std::swap(cur, other);
+    }
+  }
+  if (cur != res) {
+    std::copy(cur, cur + len, res);
+  }
+  return len;
+}
+
+// u^k 2^prec for the fixed-point u = x 2^-x_prec; intermediate powers are
+// cut to a few bits above prec, so the result is good to about prec bits
+big_integer fixed_pow(big_integer const& x, int x_prec, unsigned k,
+                      int prec) {
+  int cut = prec + bit_width(k) + 2;
+  big_integer res = x;
+  int res_prec = x_prec;
+  auto truncate = [&res, &res_prec, cut]() {
+    if (res_prec > cut) {
+      res >>= res_prec - cut;
+      res_prec = cut;
+    }
+  };
+  for (int i = bit_width(k) - 2; i >= 0; i--) {
+    res = sqr(res);
+    res_prec *= 2;
+    truncate();
+    if ((k >> i) & 1) {
+      res *= x;
+      res_prec += x_prec;
+      truncate();
+    }
+  }
+  if (res_prec > prec) {
+    res >>= res_prec - prec;
+  } else {
+    res <<= prec - res_prec;
+  }
+  return res;
+}
+
+// rem[j] = a[0, n) mod d[j] for every j, all moduli in one pass over a
+void mod_limbs(limb_t const* a, size_t n, limb_t const* d, limb_t* rem,
+               size_t count) {
+  std::fill(rem, rem + count, 0);
+  for (size_t i = n; i >= 1; i--) {
+    for (size_t j = 0; j < count; j++) {
+      double_limb_t cur =
+          (static_cast<double_limb_t>(rem[j]) << LIMB_BITS) | a[i - 1];
+      rem[j] = static_cast<limb_t>(cur % d[j]);
+    }
+  }
+}
+
+const uint32_t SMALL_PRIME_LIMIT = 1 << 16;
+
+// odd primes below SMALL_PRIME_LIMIT in ascending groups whose products fit
+// a limb, so a single remainder per group covers all of its primes
+struct small_primes {
+  std::vector<uint32_t> primes;
+  std::vector<limb_t> products;
+  // group j holds primes[first[j], first[j + 1])
+  std::vector<size_t> first;
+};
+
+small_primes const& get_small_primes() {
+  static small_primes const res = [] {
+    small_primes s;
+    std::vector<bool> composite(SMALL_PRIME_LIMIT);
+    for (uint32_t p = 3; p < SMALL_PRIME_LIMIT; p += 2) {
+      if (composite[p]) {
+        continue;
+      }
+      for (size_t q = size_t(p) * p; q < SMALL_PRIME_LIMIT; q += 2 * p) {
+        composite[q] = true;
+      }
+      if (s.products.empty() ||
+          s.products.back() > std::numeric_limits<limb_t>::max() / p) {
+        s.first.push_back(s.primes.size());
+        s.products.push_back(p);
+      } else {
+        s.products.back() *= p;
+      }
+      s.primes.push_back(p);
+    }
+    s.first.push_back(s.primes.size());
+    return s;
+  }();
+  return res;
+}
+
+// a[0, n) mod p for the primes of the first `groups` groups
+std::vector<uint32_t> small_prime_residues(limb_t const* a, size_t n,
+                                           size_t groups) {
+  small_primes const& s = get_small_primes();
+  limbs rem(groups);
+  mod_limbs(a, n, s.products.data(), rem.data(), groups);
+  std::vector<uint32_t> res(s.first[groups]);
+  for (size_t j = 0; j < groups; j++) {
+    for (size_t i = s.first[j]; i < s.first[j + 1]; i++) {
+      res[i] = static_cast<uint32_t>(rem[j] % s.primes[i]);
+    }
+  }
+  return res;
+}
+
+// Jacobi symbol (a / n) for odd n
+int jacobi(uint64_t a, uint64_t n) {
+  a %= n;
+  int res = 1;
+  while (a != 0) {
+    while (a % 2 == 0) {
+      a /= 2;
+      if (n % 8 == 3 || n % 8 == 5) {
+        res = -res;
+      }
+    }
+    std::swap(a, n);
+    if (a % 4 == 3 && n % 4 == 3) {
+      res = -res;
+    }
+    a %= n;
+  }
+  return n == 1 ? res : 0;
+}
+
+big_integer add_mod(big_integer a, big_integer const& b,
+                    big_integer const& n) {
+  a += b;
+  if (a >= n) {
+    a -= n;
+  }
+  return a;
+}
+
+big_integer sub_mod(big_integer a, big_integer const& b,
+                    big_integer const& n) {
+  a -= b;
+  if (a < 0) {
+    a += n;
+  }
+  return a;
+}
+
+// a / 2 mod odd n for a in [0, n)
+big_integer half_mod(big_integer a, big_integer const& n) {
+  if ((a & 1) != 0) {
+    a += n;
+  }
+  return a >>= 1;
+}
+
+// strong probable prime test of odd n > 3 to the given base, n - 1 = d 2^s
+bool miller_rabin(big_integer_montgomery const& ctx, big_integer const& n,
+                  big_integer const& d, int s, big_integer const& base) {
+  big_integer x = ctx.pow(base, d);
+  if (x == 1 || x == n - 1) {
+    return true;
+  }
+  // the remaining squarings stay in Montgomery form
+  big_integer minus_one = ctx.to_montgomery(n - 1);
+  x = ctx.to_montgomery(x);
+  for (int i = 1; i < s; i++) {
+    x = ctx.mul(x, x);
+    if (x == minus_one) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// strong Lucas probable prime test of odd n with Selfridge's parameters
+// P = 1, Q = (1 - d) / 4, where d is the first of 5, -7, 9, -11, ... with
+// Jacobi symbol (d / n) = -1
+bool strong_lucas(big_integer_montgomery const& ctx, big_integer const& n,
+                  long long d) {
+  auto form = [&ctx, &n](long long v) {
+    big_integer res = big_integer(v) % n;
+    if (res < 0) {
+      res += n;
+    }
+    return ctx.to_montgomery(res);
+  };
+  big_integer d_form = form(d);
+  big_integer q_form = form((1 - d) / 4);
+
+  big_integer k = n + 1;
+  int s = 0;
+  while ((k & 1) == 0) {
+    k >>= 1;
+    s++;
+  }
+  std::vector<bool> bits;
+  for (; k != 0; k >>= 1) {
+    bits.push_back((k & 1) != 0);
+  }
+  // U_k, V_k and Q^k in Montgomery form for the leading bits k of
+  // (n + 1) / 2^s, starting from k = 1
+  big_integer u = ctx.to_montgomery(1);
+  big_integer v = u;
+  big_integer qk = q_form;
+  for (size_t i = bits.size() - 1; i >= 1; i--) {
+    // U_2k = U_k V_k, V_2k = V_k^2 - 2 Q^k
+    u = ctx.mul(u, v);
+    v = sub_mod(ctx.mul(v, v), add_mod(qk, qk, n), n);
+    qk = ctx.mul(qk, qk);
+    if (bits[i - 1]) {
+      // U_k+1 = (U_k + V_k) / 2, V_k+1 = (D U_k + V_k) / 2
+      big_integer du = ctx.mul(d_form, u);
+      u = half_mod(add_mod(u, v, n), n);
+      v = half_mod(add_mod(du, v, n), n);
+      qk = ctx.mul(qk, q_form);
+    }
+  }
+  if (u == 0 || v == 0) {
+    return true;
+  }
+  for (int i = 1; i < s; i++) {
+    v = sub_mod(ctx.mul(v, v), add_mod(qk, qk, n), n);
+    if (v == 0) {
+      return true;
+    }
+    qk = ctx.mul(qk, qk);
+  }
+  return false;
+}
+} // namespace
+
+// Transformation from the pair a gcd computation started with to the
+// current one: x = m[0][0] x0 + m[0][1] y0 and y = m[1][0] x0 + m[1][1] y0.
+struct big_integer::gcd_matrix {
+  big_integer m[2][2] = {{1, 0}, {0, 1}};
+
+  void swap_rows() {
+    for (size_t j = 0; j < 2; j++) {
+      swap(m[0][j], m[1][j]);
+    }
+  }
+
+  void negate_row(size_t i) {
+    for (size_t j = 0; j < 2; j++) {
+      m[i][j].negate();
+    }
+  }
+
+  // the Euclid step x -= q y
+  void submul_row(big_integer const& q) {
+    for (size_t j = 0; j < 2; j++) {
+      m[0][j].submul(q, m[1][j]);
+    }
+  }
+
+  void combine(lehmer_cofactors const& f) {
+    for (size_t j = 0; j < 2; j++) {
+      big_integer& u = m[0][j];
+      big_integer& v = m[1][j];
+      if (u.is_neg != v.is_neg || u.arr.empty() || v.arr.empty()) {
+        // signs as in Euclid's cofactor sequences: the magnitudes only add
+        bool u_neg = (u.arr.empty() ? !v.is_neg : u.is_neg) != f.odd;
+        bool v_neg = (v.arr.empty() ? !u.is_neg : v.is_neg) != f.odd;
+        size_t len = std::max(u.arr.size(), v.arr.size()) + 1;
+        u.arr.resize(len, 0);
+        v.arr.resize(len, 0);
+        mul_add_carry ru;
+        mul_add_carry rv;
+        for (size_t i = 0; i < len; i++) {
+          limb_t ui = u.arr[i];
+          limb_t vi = v.arr[i];
+          u.arr[i] = ru.next(ui, f.a, vi, f.b);
+          v.arr[i] = rv.next(ui, f.c, vi, f.d);
+        }
+        u.is_neg = u_neg;
+        v.is_neg = v_neg;
+        u.remove_leading();
+        v.remove_leading();
+        continue;
+      }
+      big_integer new_u;
+      new_u.addmul_1(u, f.a).submul_1(v, f.b);
+      big_integer new_v;
+      new_v.addmul_1(v, f.d).submul_1(u, f.c);
+      if (f.odd) {
+        new_u.negate();
+        new_v.negate();
+      }
+      u = std::move(new_u);
+      v = std::move(new_v);
+    }
+  }
+
+  // *this = r * *this
+  void apply(gcd_matrix const& r) {
+    for (size_t j = 0; j < 2; j++) {
+      big_integer& u = m[0][j];
+      big_integer& v = m[1][j];
+      big_integer new_u = r.m[0][0] * u;
+      new_u.addmul(r.m[0][1], v);
+      big_integer new_v = r.m[1][0] * u;
+      new_v.addmul(r.m[1][1], v);
+      u = std::move(new_u);
+      v = std::move(new_v);
+    }
+  }
+};
+
+big_integer::big_integer() = default;
+
+big_integer::big_integer(big_integer const& other) = default;
+
+big_integer::big_integer(big_integer&& other) noexcept
+    : arr(std::move(other.arr)), is_neg(other.is_neg) {
+  other.is_neg = false;
+}
+
+big_integer::big_integer(int a) : is_neg(a < 0) {
+  init_big(magnitude(a));
+}
+
+big_integer::big_integer(unsigned long long a) {
+  init_big(a);
+}
+
+big_integer::big_integer(long long a) : is_neg(a < 0) {
+  init_big(magnitude(a));
+}
+
+big_integer::big_integer(unsigned int a) {
+  init_big(static_cast<unsigned long long>(a));
+}
+
+big_integer::big_integer(long a) : is_neg(a < 0) {
+  init_big(magnitude(a));
+}
+
+big_integer::big_integer(unsigned long a) {
+  init_big(static_cast<unsigned long long>(a));
+}
+
+namespace {
+
+// value of a digit in the bases up to 36, 36 for anything else
+unsigned digit_value(char c) {
+  auto digit = static_cast<unsigned char>(c - '0');
+  auto letter = static_cast<unsigned char>((c | 0x20) - 'a');
+  return digit <= 9 ? digit : letter <= 25 ? letter + 10u : 36u;
+}
+
+} // namespace
+
+// Digits of a base other than a power of two are converted in blocks: size
+// digits make up a number below pow = base^size, the largest such power
+// that fits 32 bits.
+struct big_integer::radix {
+  explicit radix(int base) : base(base) {
+    if (base < 2 || base > 36) {
+      throw std::invalid_argument("Base has to lie in [2, 36]");
+    }
+    uint64_t p = base;
+    while (p * base <= std::numeric_limits<uint32_t>::max()) {
+      p *= base;
+      size++;
+    }
+    pow = static_cast<uint32_t>(p);
+    while ((static_cast<uint64_t>(1) << (bits + 1)) <= pow) {
+      bits++;
+    }
+    if ((base & (base - 1)) == 0) {
+      while ((1 << digit_bits) < base) {
+        digit_bits++;
+      }
+    }
+  }
+
+  // the digits of a[0, n) to out, returns their end. write divides a down
+  // and pads to width digits unless width is 0, write_bits is for powers of
+  // two and leaves a alone.
+  char* write(limb_t* a, size_t n, size_t width, char* out) const;
+  char* write_bits(limb_t const* a, size_t n, char* out) const;
+
+  uint32_t base;
+  size_t size{1};
+  uint32_t pow;
+  // a block takes at least that many bits off a value
+  int bits{0};
+  // bits of a digit for powers of two, 0 for the other bases
+  int digit_bits{0};
+};
+
+big_integer::big_integer(std::string const& str) : big_integer(str, 10) {}
+
+big_integer::big_integer(std::string const& str, int base) : big_integer() {
+  radix r(base);
+  if (str.empty()) {
+    throw std::invalid_argument("String has to be non-empty");
+  }
+  size_t first = (str[0] == '-' ? 1 : 0);
+  if (str.length() == 1 && first == 1) {
+    throw std::invalid_argument("String cannot be just '-'");
+  }
+  // no early exit, so the scan vectorizes
+  unsigned char invalid = 0;
+  for (size_t i = first; i < str.length(); i++) {
+    invalid |= digit_value(str[i]) >= r.base ? 1 : 0;
+  }
+  if (invalid != 0) {
+    throw std::invalid_argument(
+        "String has to contain only digits of the base");
+  }
+  *this = from_digits(str.data() + first, str.length() - first, r);
+  if (first == 1) {
+    negate();
+  }
+}
+
+// value of the digits [first, first + len), already checked against the base
+big_integer big_integer::from_digits(char const* first, size_t len,
+                                     radix const& r) {
+  if (r.digit_bits != 0) {
+    // every digit goes straight to its bits
+    big_integer res;
+    res.arr.resize((len * r.digit_bits + LIMB_BITS - 1) / LIMB_BITS, 0);
+    for (size_t i = 0; i < len; i++) {
+      size_t pos = i * r.digit_bits;
+      int shift = static_cast<int>(pos % LIMB_BITS);
+      auto digit = static_cast<limb_t>(digit_value(first[len - 1 - i]));
+      res.arr[pos / LIMB_BITS] |= digit << shift;
+      if (shift > LIMB_BITS - r.digit_bits) {
+        res.arr[pos / LIMB_BITS + 1] |= digit >> (LIMB_BITS - shift);
+      }
+    }
+    return res.remove_leading();
+  }
+  std::vector<big_integer> pows{r.pow};
+  while ((r.size << pows.size()) < len) {
+    pows.push_back(pows.back() * pows.back());
+  }
+  return parse_digits(first, len, r, pows);
+}
+
+big_integer::big_integer(limb_t const* first, limb_t const* last,
+                         bool negative)
+    : is_neg(negative) {
+  arr.assign(first, last);
+  remove_leading();
+}
+
+big_integer::limb_t const* big_integer::limb_data() const {
+  return arr.data();
+}
+
+size_t big_integer::limb_count() const {
+  return arr.size();
+}
+
+bool big_integer::is_negative() const {
+  return is_neg;
+}
+
+// value of the digits [first, first + len), the lower size * 2^k digits of
+// long inputs are split off and combined through pows[k] = pow^(2^k)
+big_integer big_integer::parse_digits(char const* first, size_t len,
+                                      radix const& r,
+                                      std::vector<big_integer> const& pows) {
+  if (len <= r.size * thresholds.radix_conversion) {
+    big_integer res;
+    for (size_t i = 0; i < len; i += r.size) {
+      size_t block = std::min(r.size, len - i);
+      limb_t cur = 0;
+      limb_t pow = 1;
+      for (size_t k = 0; k < block; k++) {
+        cur = cur * r.base + digit_value(first[i + k]);
+        pow *= r.base;
+      }
+      res.small_mul(pow);
+      res.add_magnitude(&cur, cur != 0 ? 1 : 0, false);
+    }
+    return res;
+  }
+  size_t k = 0;
+  while ((r.size << (k + 1)) < len) {
+    k++;
+  }
+  size_t low_len = r.size << k;
+  big_integer res = parse_digits(first, len - low_len, r, pows);
+  res *= pows[k];
+  res += parse_digits(first + len - low_len, low_len, r, pows);
+  return res;
+}
+
+big_integer::~big_integer() = default;
+
+void big_integer::resize(size_t new_size, limb_t val) {
+  if (new_size <= arr.size()) {
+    return;
+  }
+  arr.resize(new_size, val);
+}
+
+big_integer& big_integer::operator=(big_integer const& other) {
+  arr = other.arr;
+  is_neg = other.is_neg;
+  return *this;
+}
+
+big_integer& big_integer::operator=(big_integer&& other) noexcept {
+  if (this != &other) {
+    arr = std::move(other.arr);
+    is_neg = other.is_neg;
+    other.is_neg = false;
+  }
+  return *this;
+}
+
+
+big_integer& big_integer::remove_leading() {
+  while (!arr.empty() && arr.back() == 0) {
+    arr.pop_back();
+  }
+  if (arr.empty()) {
+    is_neg = false;
+  }
+  return *this;
+}
+
+big_integer& big_integer::operator+=(big_integer const& rhs) {
+  add_magnitude(rhs.arr.data(), rhs.arr.size(), rhs.is_neg);
+  return *this;
+}
+
+void big_integer::add_int(int32_t num) {
+  limb_t mag = magnitude(num);
+  add_magnitude(&mag, mag != 0 ? 1 : 0, num < 0);
+}
+
+// *this += (b_neg ? -1 : 1) * b[0, m); b may point into the limbs of *this
+void big_integer::add_magnitude(limb_t const* b, size_t m, bool b_neg) {
+  size_t n = arr.size();
+  if (is_neg == b_neg || n == 0) {
+    is_neg = b_neg;
+    if (n < m) {
+      arr.resize(m, 0);
+    }
+    limb_t carry = add_limbs(arr.data(), arr.size(), b, m);
+    if (carry != 0) {
+      arr.push_back(carry);
+    }
+  } else if (cmp_limbs(arr.data(), n, b, m) >= 0) {
+    sub_limbs(arr.data(), n, b, m);
+  } else {
+    arr.resize(m, 0);
+    rsub_limbs(arr.data(), b, m);
+    is_neg = b_neg;
+  }
+  remove_leading();
+}
+
+big_integer& big_integer::operator-=(big_integer const& rhs) {
+  add_magnitude(rhs.arr.data(), rhs.arr.size(), !rhs.is_neg);
+  return *this;
+}
+
+// the product goes through scratch limbs, the storage of *this is reused
+// when large enough
+big_integer& big_integer::operator*=(big_integer const& rhs) {
+  size_t len = arr.size() + rhs.arr.size();
+  scratch_limbs res(len);
+  mul_limbs(res.data(), arr.data(), arr.size(), rhs.arr.data(),
+            rhs.arr.size());
+  arr.assign(res.data(), res.data() + len);
+  is_neg = is_neg != rhs.is_neg;
+  return remove_leading();
+}
+
+big_integer& big_integer::small_mul(limb_t rhs) {
+  limb_t carry = 0;
+  for (limb_t& i : arr) {
+    double_limb_t res = static_cast<double_limb_t>(i) * rhs + carry;
+    i = static_cast<limb_t>(res);
+    carry = res >> LIMB_BITS;
+  }
+  if (carry) {
+    arr.push_back(carry);
+  }
+  return remove_leading();
+}
+
+big_integer sqr(big_integer const& a) {
+  return a * a;
+}
+
+big_integer& big_integer::addmul(big_integer const& a, big_integer const& b) {
+  return fused_mul(a, b, false);
+}
+
+big_integer& big_integer::submul(big_integer const& a, big_integer const& b) {
+  return fused_mul(a, b, true);
+}
+
+big_integer& big_integer::addmul_1(big_integer const& a, limb_t b) {
+  return fused_mul_1(a, b, false);
+}
+
+big_integer& big_integer::submul_1(big_integer const& a, limb_t b) {
+  return fused_mul_1(a, b, true);
+}
+
+big_integer& big_integer::fused_mul(big_integer const& a, big_integer const& b,
+                                    bool subtract) {
+  if (&a == this || &b == this) {
+    return subtract ? *this -= a * b : *this += a * b;
+  }
+  accumulate_product(a.arr.data(), a.arr.size(), b.arr.data(), b.arr.size(),
+                     subtract ^ a.is_neg ^ b.is_neg);
+  return *this;
+}
+
+big_integer& big_integer::fused_mul_1(big_integer const& a, limb_t b,
+                                      bool subtract) {
+  if (&a == this) {
+    big_integer copy = a;
+    return fused_mul_1(copy, b, subtract);
+  }
+  accumulate_product(a.arr.data(), a.arr.size(), &b, 1, subtract ^ a.is_neg);
+  return *this;
+}
+
+// *this +-= a[0, n) * b[0, m) in the limbs of *this. The magnitude gets one
+// limb of headroom; if a subtraction wraps around, the sign flips and the
+// magnitude is recovered by a two's complement negation.
+void big_integer::accumulate_product(limb_t const* a, size_t n,
+                                     limb_t const* b, size_t m,
+                                     bool subtract) {
+  n = trimmed_size(a, n);
+  m = trimmed_size(b, m);
+  if (n == 0 || m == 0) {
+    return;
+  }
+  if (n < m) {
+    std::swap(a, b);
+    std::swap(n, m);
+  }
+  bool sub_magnitude = (subtract != is_neg);
+  size_t len = std::max(arr.size(), n + m) + 1;
+  resize(len, 0);
+  limb_t* acc = arr.data();
+  if (m < karatsuba_threshold()) {
+    for (size_t j = 0; j < m; j++) {
+      limb_t carry = sub_magnitude ? submul_limbs_1(acc + j, a, n, b[j])
+                                   : addmul_limbs_1(acc + j, a, n, b[j]);
+      if (sub_magnitude) {
+        sub_limbs(acc + j + n, len - j - n, &carry, 1);
+      } else {
+        add_limbs(acc + j + n, len - j - n, &carry, 1);
+      }
+    }
+  } else {
+    scratch_limbs prod(n + m);
+    mul_limbs(prod.data(), a, n, b, m);
+    if (sub_magnitude) {
+      sub_limbs(acc, len, prod.data(), n + m);
+    } else {
+      add_limbs(acc, len, prod.data(), n + m);
+    }
+  }
+  if (acc[len - 1] >> (LIMB_BITS - 1) != 0) {
+    negate_limbs(acc, len);
+    is_neg = !is_neg;
+  }
+  remove_leading();
+}
+
+big_integer& big_integer::operator/=(big_integer const& rhs) {
+  knut_div(rhs, DivType::Quot);
+  return *this;
+}
+
+big_integer& big_integer::operator%=(big_integer const& rhs) {
+  knut_div(rhs, DivType::Remainder);
+  return *this;
+}
+
+void big_integer::knut_div(const big_integer& rhs, DivType type) {
+  if (rhs == 0) {
+    throw std::invalid_argument("big_integer division by zero");
+  }
+  if (&rhs == this) {
+    (*this) = type == DivType::Quot ? 1 : 0;
+    return;
+  }
+  bool quot_neg = (is_neg != rhs.is_neg);
+  if (cmp_limbs(arr.data(), arr.size(), rhs.arr.data(), rhs.arr.size()) < 0) {
+    if (type == DivType::Quot) {
+      *this = 0;
+    }
+    return;
+  }
+  size_t n = rhs.arr.size();
+  if (n == 1) {
+    limb_t rem = div_with_rem(rhs.arr[0]);
+    if (type == DivType::Remainder) {
+      bool was_neg = is_neg;
+      *this = rem;
+      is_neg = was_neg;
+    } else {
+      is_neg = quot_neg;
+    }
+    remove_leading();
+    return;
+  }
+  int shift = normalization_shift(rhs.arr.back());
+  bool was_neg = is_neg;
+  // normalized copies of both operands and the quotient live in scratch
+  // limbs, the result is written back into the storage of *this; the
+  // reciprocal pays off only for quotients about as long as the divisor
+  size_t m = arr.size() - n;
+  bool barrett = n >= thresholds.newton_div && m >= n;
+  size_t q_len = quotient_size(m, n, barrett);
+  scratch_limbs buf(n + (m + n + 1) + q_len + (barrett ? n + 1 : 0));
+  limb_t* v = buf.data();
+  limb_t* u = v + n;
+  limb_t* q = u + m + n + 1;
+  limb_t* inv = barrett ? q + q_len : nullptr;
+  shl_limbs(v, rhs.arr.data(), n, shift);
+  shl_limbs(u, arr.data(), m + n, shift);
+  if (barrett) {
+    reciprocal_limbs(inv, v, n);
+  }
+  div_normalized(q, u, m, v, n, inv);
+  if (type == DivType::Quot) {
+    arr.assign(q, q + q_len);
+  } else {
+    shr_limbs(u, u, n, shift);
+    arr.assign(u, u + n);
+  }
+  is_neg = type == DivType::Quot ? quot_neg : was_neg;
+  remove_leading();
+}
+
+big_integer big_integer::from_limbs(limb_t const* first,
+                                    limb_t const* last) {
+  big_integer res;
+  res.arr.assign(first, last);
+  res.remove_leading();
+  return res;
+}
+
+big_integer_divisor::big_integer_divisor(big_integer const& d)
+    : norm(d), neg(d.is_neg) {
+  if (d == 0) {
+    throw std::invalid_argument("big_integer division by zero");
+  }
+  norm.absolutify();
+  shift = normalization_shift(norm.arr.back());
+  norm <<= shift;
+  if (norm.arr.size() >= big_integer::thresholds.newton_div) {
+    inv.resize(norm.arr.size() + 1, 0);
+    reciprocal_limbs(inv.arr.data(), norm.arr.data(), norm.arr.size());
+  }
+}
+
+// the normalized dividend lives in scratch limbs, the quotient and the
+// remainder are written into the storage of q and r; either may be a
+void big_integer_divisor::divmod(big_integer const& a, big_integer& q,
+                                 big_integer& r) const {
+  bool a_neg = a.is_neg;
+  size_t n = norm.arr.size();
+  if (n == 1) {
+    q = a;
+    limb_t rem = q.div_with_rem(norm.arr[0] >> shift);
+    r.arr.assign(&rem, &rem + 1);
+  } else if (a.arr.size() < n) {
+    r = a;
+    q.arr.clear();
+  } else {
+    size_t m = a.arr.size() - n;
+    scratch_limbs u(m + n + 1);
+    shl_limbs(u.data(), a.arr.data(), m + n, shift);
+    q.arr.resize(quotient_size(m, n, !inv.arr.empty()));
+    div_normalized(q.arr.data(), u.data(), m, norm.arr.data(), n,
+                   inv.arr.empty() ? nullptr : inv.arr.data());
+    shr_limbs(u.data(), u.data(), n, shift);
+    r.arr.assign(u.data(), u.data() + n);
+  }
+  q.is_neg = a_neg != neg;
+  q.remove_leading();
+  r.is_neg = a_neg;
+  r.remove_leading();
+}
+
+big_integer big_integer_divisor::div(big_integer const& a) const {
+  big_integer q;
+  big_integer r;
+  divmod(a, q, r);
+  return q;
+}
+
+big_integer big_integer_divisor::mod(big_integer const& a) const {
+  big_integer q;
+  big_integer r;
+  divmod(a, q, r);
+  return r;
+}
+
+big_integer_montgomery::big_integer_montgomery(big_integer const& m)
+    : mod(m) {
+  mod.absolutify();
+  if (mod.arr.empty() || (mod.arr[0] & 1) == 0) {
+    throw std::invalid_argument("Montgomery modulus has to be odd");
+  }
+  // Newton iteration for m^-1 mod B, each step doubles the correct bits
+  limb_t inv = mod.arr[0];
+  for (int i = 0; i < 6; i++) {
+    inv *= 2 - mod.arr[0] * inv;
+  }
+  neg_inv = 0 - inv;
+  size_t n = mod.arr.size();
+  big_integer r = (big_integer(1) << static_cast<int>(LIMB_BITS * n)) % mod;
+  big_integer r_sqr = r * r % mod;
+  one.assign(n, 0);
+  std::copy(r.arr.begin(), r.arr.end(), one.begin());
+  r2.assign(n, 0);
+  std::copy(r_sqr.arr.begin(), r_sqr.arr.end(), r2.begin());
+}
+
+// left-to-right sliding window over the odd powers base^1, base^3, ...,
+// all values are kept in Montgomery form x * B^n mod m
+big_integer big_integer_montgomery::pow(big_integer const& base,
+                                        big_integer const& exp) const {
+  if (exp.is_neg) {
+    throw std::invalid_argument("powmod exponent has to be non-negative");
+  }
+  size_t n = mod.arr.size();
+  limb_t const* m = mod.arr.data();
+  size_t bits = exp.arr.empty() ? 0
+                                : LIMB_BITS * exp.arr.size() -
+                                      normalization_shift(exp.arr.back());
+  int k = window_bits(bits);
+  size_t table = size_t(1) << (k - 1);
+  // t, the accumulator, the square of the base and the odd powers
+  scratch_limbs buf((2 * n + 1) + n + n + table * n);
+  limb_t* t = buf.data();
+  limb_t* acc = t + 2 * n + 1;
+  limb_t* sqr = acc + n;
+  limb_t* odd_pows = sqr + n;
+  std::copy(one.begin(), one.end(), acc);
+
+  if (bits > 0) {
+    reduce_limbs(odd_pows, base.arr.data(), base.arr.size(), base.is_neg, m,
+                 n);
+    mont_mul(odd_pows, odd_pows, r2.data(), m, n, neg_inv, t);
+    mont_mul(sqr, odd_pows, odd_pows, m, n, neg_inv, t);
+    for (size_t i = 1; i < table; i++) {
+      mont_mul(odd_pows + i * n, odd_pows + (i - 1) * n, sqr, m, n, neg_inv,
+               t);
+    }
+    auto bit = [&exp](size_t i) {
+      return (exp.arr[i / LIMB_BITS] >> (i % LIMB_BITS)) & 1;
+    };
+    bool started = false;
+    for (size_t i = bits; i >= 1;) {
+      if (bit(i - 1) == 0) {
+        mont_mul(acc, acc, acc, m, n, neg_inv, t);
+        i--;
+        continue;
+      }
+      // the window [low, i) starts and ends with a set bit
+      size_t low = i > static_cast<size_t>(k) ? i - k : 0;
+      while (bit(low) == 0) {
+        low++;
+      }
+      size_t window = 0;
+      for (size_t j = i; j > low; j--) {
+        window = 2 * window + bit(j - 1);
+        if (started) {
+          mont_mul(acc, acc, acc, m, n, neg_inv, t);
+        }
+      }
+      limb_t const* factor = odd_pows + window / 2 * n;
+      if (started) {
+        mont_mul(acc, acc, factor, m, n, neg_inv, t);
+      } else {
+        std::copy(factor, factor + n, acc);
+        started = true;
+      }
+      i = low;
+    }
+  }
+  std::fill(t, t + 2 * n + 1, 0);
+  std::copy(acc, acc + n, t);
+  redc(acc, t, m, n, neg_inv);
+  return big_integer::from_limbs(acc, acc + n);
+}
+
+big_integer big_integer_montgomery::to_montgomery(big_integer const& a) const {
+  size_t n = mod.arr.size();
+  scratch_limbs buf(n + (2 * n + 1));
+  limb_t* x = buf.data();
+  limb_t* t = x + n;
+  reduce_limbs(x, a.arr.data(), a.arr.size(), a.is_neg, mod.arr.data(), n);
+  mont_mul(x, x, r2.data(), mod.arr.data(), n, neg_inv, t);
+  return big_integer::from_limbs(x, x + n);
+}
+
+big_integer
+big_integer_montgomery::from_montgomery(big_integer const& a) const {
+  size_t n = mod.arr.size();
+  scratch_limbs t(2 * n + 1);
+  std::fill(t.data(), t.data() + 2 * n + 1, 0);
+  std::copy(a.arr.begin(), a.arr.end(), t.data());
+  redc(t.data(), t.data(), mod.arr.data(), n, neg_inv);
+  return big_integer::from_limbs(t.data(), t.data() + n);
+}
+
+big_integer big_integer_montgomery::mul(big_integer const& a,
+                                        big_integer const& b) const {
+  size_t n = mod.arr.size();
+  scratch_limbs buf(n + n + (2 * n + 1));
+  limb_t* x = buf.data();
+  limb_t* y = x + n;
+  limb_t* t = y + n;
+  std::fill(x, x + 2 * n, 0);
+  std::copy(a.arr.begin(), a.arr.end(), x);
+  std::copy(b.arr.begin(), b.arr.end(), y);
+  mont_mul(x, x, y, mod.arr.data(), n, neg_inv, t);
+  return big_integer::from_limbs(x, x + n);
+}
+
+big_integer powmod(big_integer const& base, big_integer const& exp,
+                   big_integer const& mod) {
+  if (mod == 0) {
+    throw std::invalid_argument("big_integer division by zero");
+  }
+  if ((mod % 2) != 0) {
+    return big_integer_montgomery(mod).pow(base, exp);
+  }
+  if (exp < 0) {
+    throw std::invalid_argument("powmod exponent has to be non-negative");
+  }
+  // even moduli: plain square and multiply with a reused divisor
+  big_integer_divisor d(mod);
+  big_integer res = d.mod(1);
+  big_integer cur = d.mod(base);
+  big_integer e = exp;
+  while (e != 0) {
+    if ((e & 1) != 0) {
+      res = d.mod(res * cur);
+    }
+    cur = d.mod(cur * cur);
+    e >>= 1;
+  }
+  if (res < 0) {
+    res += mod < 0 ? -mod : mod;
+  }
+  return res;
+}
+
+// (x, y) = (y, x mod y)
+void big_integer::euclid_step(big_integer& x, big_integer& y, gcd_matrix* m) {
+  if (m == nullptr) {
+    x %= y;
+  } else {
+    big_integer q = x / y;
+    x.submul(q, y);
+    m->submul_row(q);
+    m->swap_rows();
+  }
+  swap(x, y);
+}
+
+// Euclid's algorithm on x >= y >= 0 until y has at most target limbs: each
+// round runs the steps the two leading limbs determine and applies them to
+// the whole numbers at once, a full division is needed only when the
+// leading limbs do not settle a single quotient.
+void big_integer::lehmer_reduce(big_integer& x, big_integer& y, size_t target,
+                                gcd_matrix* m) {
+  while (y.arr.size() > target) {
+    size_t n = x.arr.size();
+    if (m == nullptr && n <= 2) {
+      double_limb_t u = top_bits(x.arr.data(), n, 0);
+      double_limb_t v = top_bits(y.arr.data(), y.arr.size(), 0);
+      while (v != 0) {
+        u %= v;
+        std::swap(u, v);
+      }
+      limb_t res[2] = {static_cast<limb_t>(u),
+                       static_cast<limb_t>(u >> LIMB_BITS)};
+      x = from_limbs(res, res + 2);
+      y = 0;
+      return;
+    }
+    size_t bits = n * LIMB_BITS - normalization_shift(x.arr.back());
+    size_t shift = bits > 2 * LIMB_BITS - 1 ? bits - (2 * LIMB_BITS - 1) : 0;
+    lehmer_cofactors f =
+        lehmer_simulate(top_bits(x.arr.data(), n, shift),
+                        top_bits(y.arr.data(), y.arr.size(), shift));
+    if (f.b == 0) {
+      euclid_step(x, y, m);
+      continue;
+    }
+    y.arr.resize(n, 0);
+    lehmer_update(x.arr.data(), y.arr.data(), n, f);
+    x.remove_leading();
+    y.remove_leading();
+    if (m != nullptr) {
+      m->combine(f);
+    }
+  }
+}
+
+// Reduces x >= y >= 0 until y has at most target limbs, where target is at
+// least half the length of x. The steps are found recursively on the leading
+// limbs, which decide about half of them, and applied to x and y as one
+// matrix product. Steps found this way may deviate from Euclid's near the
+// end; any unimodular transformation keeps the gcd, so the pair only has to
+// be brought back to x >= y >= 0.
+void big_integer::half_gcd(big_integer& x, big_integer& y, size_t target,
+                           gcd_matrix* m) {
+  while (y.arr.size() > target) {
+    size_t n = x.arr.size();
+    size_t d = n - target;
+    size_t strip = 2 * d + 2 < n ? d : (d + 1) / 2;
+    if (2 * d < thresholds.half_gcd_base || n < 2 * strip + 3) {
+      lehmer_reduce(x, y, target, m);
+      return;
+    }
+    size_t k = n - 2 * strip - 2;
+    big_integer top_x = from_limbs(x.arr.data() + k, x.arr.data() + n);
+    big_integer top_y;
+    if (y.arr.size() > k) {
+      top_y = from_limbs(y.arr.data() + k, y.arr.data() + y.arr.size());
+    }
+    gcd_matrix r;
+    half_gcd(top_x, top_y, n - strip - k, &r);
+
+    // r (x, y) = r (top_x, top_y) B^k + r (low_x, low_y), where the first
+    // term is what the recursion left in top_x and top_y
+    big_integer low_x = from_limbs(x.arr.data(), x.arr.data() + k);
+    big_integer low_y = from_limbs(
+        y.arr.data(), y.arr.data() + std::min(k, y.arr.size()));
+    top_x <<= static_cast<int>(k * LIMB_BITS);
+    top_y <<= static_cast<int>(k * LIMB_BITS);
+    x = r.m[0][0] * low_x;
+    x.addmul(r.m[0][1], low_y);
+    x += top_x;
+    y = r.m[1][0] * low_x;
+    y.addmul(r.m[1][1], low_y);
+    y += top_y;
+    if (m != nullptr) {
+      m->apply(r);
+    }
+    for (size_t i = 0; i < 2; i++) {
+      big_integer& v = (i == 0 ? x : y);
+      if (v.is_neg) {
+        v.negate();
+        if (m != nullptr) {
+          m->negate_row(i);
+        }
+      }
+    }
+    if (x < y) {
+      swap(x, y);
+      if (m != nullptr) {
+        m->swap_rows();
+      }
+    }
+    // guarantees progress even if the leading limbs decided nothing
+    if (y.arr.size() > target) {
+      euclid_step(x, y, m);
+    }
+  }
+}
+
+// x = gcd(x, y) and y = 0 for x >= y >= 0
+void big_integer::gcd_reduce(big_integer& x, big_integer& y, gcd_matrix* m) {
+  while (!y.arr.empty()) {
+    size_t n = x.arr.size();
+    if (n < thresholds.half_gcd) {
+      lehmer_reduce(x, y, 0, m);
+    } else if (y.arr.size() <= n / 2) {
+      euclid_step(x, y, m);
+    } else {
+      half_gcd(x, y, n / 2, m);
+    }
+  }
+}
+
+big_integer gcd(big_integer const& a, big_integer const& b) {
+  big_integer x = a;
+  big_integer y = b;
+  x.absolutify();
+  y.absolutify();
+  if (x < y) {
+    swap(x, y);
+  }
+  big_integer::gcd_reduce(x, y, nullptr);
+  return x;
+}
+
+big_integer xgcd(big_integer const& a, big_integer const& b, big_integer& s,
+                 big_integer& t) {
+  big_integer x = a;
+  big_integer y = b;
+  x.absolutify();
+  y.absolutify();
+  bool swapped = x < y;
+  if (swapped) {
+    swap(x, y);
+  }
+  big_integer::gcd_matrix m;
+  big_integer::gcd_reduce(x, y, &m);
+  big_integer g = std::move(x);
+
+  s = std::move(m.m[0][swapped ? 1 : 0]);
+  t = std::move(m.m[0][swapped ? 0 : 1]);
+  if (a.is_neg) {
+    s.negate();
+  }
+  if (b.is_neg) {
+    t.negate();
+  }
+  if (b != 0 && g != 0) {
+    // (s, t) -> (s - k |b| / g, t + k sign(b) a / g) moves s into range;
+    // the cofactors come out nearly reduced, so k is short
+    big_integer period = b / g;
+    period.absolutify();
+    big_integer k = s / period;
+    s.submul(k, period);
+    if (s.is_neg) {
+      s += period;
+      --k;
+    }
+    if (k != 0) {
+      big_integer step = a / g;
+      if (b.is_neg) {
+        step.negate();
+      }
+      t.addmul(k, step);
+    }
+  }
+  return g;
+}
+
+// Newton iteration for u = (a 2^(-k e))^(-1/k), a number in (1, 2], run in
+// fixed point at doubling precision from a double estimate. It needs only
+// multiplications; the root is then a u^(k - 1) 2^(-(k - 1) e), corrected
+// by at most a few units against its exact power.
+big_integer iroot(big_integer const& a, int k, big_integer& rem) {
+  if (k < 1) {
+    throw std::invalid_argument("iroot degree has to be positive");
+  }
+  if (a.is_neg && k % 2 == 0) {
+    throw std::invalid_argument("even root of a negative big_integer");
+  }
+  big_integer mag = a;
+  mag.absolutify();
+  int bits = static_cast<int>(mag.arr.size() * LIMB_BITS) -
+             (mag.arr.empty() ? 0 : normalization_shift(mag.arr.back()));
+  big_integer root;
+  if (k == 1 || mag.arr.empty()) {
+    root = mag;
+  } else if (bits <= k) {
+    root = 1;
+  } else {
+    auto uk = static_cast<unsigned>(k);
+    int e = (bits + k - 1) / k;
+    int guard = std::min(bit_width(uk) + 4, 20);
+    int frac = 32 + 2 * bit_width(uk);
+    int prec = e + frac;
+
+    int top_shift = std::max(bits - (2 * LIMB_BITS - 1), 0);
+    double log_t = std::log2(static_cast<double>(
+                       top_bits(mag.arr.data(), mag.arr.size(), top_shift))) -
+                   (static_cast<double>(k) * e - top_shift);
+    int start_prec = 40;
+    big_integer u(static_cast<unsigned long long>(
+        std::ldexp(std::exp2(-log_t / k), start_prec)));
+    // the leading p bits of a, that is a 2^(-k e) scaled by 2^(p + lost);
+    // t itself may start with up to k - 1 zero bits
+    int lost = k * e - bits;
+    auto leading = [&mag, bits](int p) {
+      return p >= bits ? mag << (p - bits) : mag >> (bits - p);
+    };
+
+    std::vector<int> steps;
+    for (int p = prec; p > start_prec && p / 2 + guard < p;
+         p = p / 2 + guard) {
+      steps.push_back(p);
+    }
+    int u_prec = start_prec;
+    for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+      int p = *it;
+      // u += u (1 - t u^k) / k
+      big_integer err =
+          (big_integer(1) << p) -
+          (leading(p) * fixed_pow(u, u_prec, uk, p) >> (p + lost));
+      big_integer step = (u * err >> u_prec) / k;
+      u <<= p - u_prec;
+      u += step;
+      u_prec = p;
+    }
+    if (u_prec > prec) {
+      u >>= u_prec - prec;
+    } else {
+      u <<= prec - u_prec;
+    }
+    big_integer approx =
+        leading(prec) * fixed_pow(u, prec, uk - 1, prec) >> (prec + lost);
+    // round up only from just below an integer, the iteration is good to a
+    // few units of 2^-frac
+    root = (approx + (big_integer(1) << (frac / 2))) >> frac;
+  }
+
+  big_integer lower = power(root, static_cast<unsigned>(k) - 1);
+  big_integer root_pow = lower * root;
+  while (root_pow > mag) {
+    --root;
+    lower = power(root, static_cast<unsigned>(k) - 1);
+    root_pow = lower * root;
+  }
+  rem = mag - root_pow;
+  // (root + 1)^k - root^k >= k root^(k - 1) + 1
+  while (rem > lower * k) {
+    big_integer next = power(root + 1, static_cast<unsigned>(k));
+    if (next > mag) {
+      break;
+    }
+    ++root;
+    lower = power(root, static_cast<unsigned>(k) - 1);
+    rem = mag - next;
+  }
+  if (a.is_neg) {
+    root.negate();
+    rem.negate();
+  }
+  return root;
+}
+
+big_integer iroot(big_integer const& a, int k) {
+  big_integer rem;
+  return iroot(a, k, rem);
+}
+
+big_integer isqrt(big_integer const& a, big_integer& rem) {
+  return iroot(a, 2, rem);
+}
+
+big_integer isqrt(big_integer const& a) {
+  big_integer rem;
+  return iroot(a, 2, rem);
+}
+
+big_integer modinv(big_integer const& a, big_integer const& mod) {
+  if (mod == 0) {
+    throw std::invalid_argument("big_integer division by zero");
+  }
+  big_integer s;
+  big_integer t;
+  if (xgcd(a, mod, s, t) != 1) {
+    throw std::invalid_argument("modinv argument is not invertible");
+  }
+  return s;
+}
+
+// Baillie-PSW and `rounds` further Miller-Rabin rounds for an odd n that
+// exceeds the square of a prime it was trial divided up to
+bool big_integer::probable_prime(big_integer const& n, int rounds) {
+  big_integer_montgomery ctx(n);
+  big_integer d = n - 1;
+  int s = 0;
+  while ((d.arr[0] & 1) == 0) {
+    d >>= 1;
+    s++;
+  }
+  if (!miller_rabin(ctx, n, d, s, 2)) {
+    return false;
+  }
+
+  // Selfridge's search for a d with (d / n) = -1, through quadratic
+  // reciprocity (|d| / n) = (n mod |d| / |d|) up to sign; a square n has no
+  // such d, this is checked once the search takes longer than usual
+  bool n_3_mod_4 = (n.arr[0] & 3) == 3;
+  long long lucas_d = 5;
+  for (int tries = 0;; tries++) {
+    limb_t abs_d = static_cast<limb_t>(lucas_d < 0 ? -lucas_d : lucas_d);
+    limb_t r;
+    mod_limbs(n.arr.data(), n.arr.size(), &abs_d, &r, 1);
+    int j = jacobi(r, abs_d);
+    if (n_3_mod_4 && (abs_d & 3) == 3) {
+      j = -j;
+    }
+    if (n_3_mod_4 && lucas_d < 0) {
+      j = -j;
+    }
+    if (j == -1) {
+      break;
+    }
+    if (j == 0 || (tries == 8 && isqrt(n) * isqrt(n) == n)) {
+      return false;
+    }
+    lucas_d = lucas_d < 0 ? 2 - lucas_d : -lucas_d - 2;
+  }
+  if (!strong_lucas(ctx, n, lucas_d)) {
+    return false;
+  }
+
+  if (rounds > 0) {
+    // bases in [2, n - 2], seeded from n so that a result is reproducible
+    std::mt19937_64 gen(n.arr[0]);
+    big_integer range = n - 3;
+    for (int i = 0; i < rounds; i++) {
+      big_integer base;
+      for (size_t j = 0; j * 64 < LIMB_BITS * n.arr.size() + 64; j++) {
+        base <<= 64;
+        base += static_cast<unsigned long long>(gen());
+      }
+      if (!miller_rabin(ctx, n, d, s, base % range + 2)) {
+        return false;
+      }
+    }
+  }
+  return true;
 }
 
-void big_integer::add_int(int32_t num) {
-  auto carry = static_cast<uint32_t>(num);
-  uint32_t num_compl = (num < 0 ? std::numeric_limits<uint32_t>::max() : 0);
-  for (size_t i = 0; i < arr.size(); i++) {
-    uint64_t res = arr[i];
-    if (i != 0) {
-      res += num_compl;
-    }
-    res += carry;
-    arr[i] = static_cast<uint32_t>(res);
-    carry = res >> 32;
-    if (carry == 0 && num_compl == 0) {
-      break;
+bool is_probable_prime(big_integer const& a, int rounds) {
+  if (a.is_neg || a.arr.empty()) {
+    return false;
+  }
+  if (a.arr.size() == 1 && a.arr[0] < 4) {
+    return a.arr[0] >= 2;
+  }
+  if ((a.arr[0] & 1) == 0) {
+    return false;
+  }
+  // short numbers are only divided by the smaller primes, Miller-Rabin is
+  // cheap for them
+  small_primes const& s = get_small_primes();
+  size_t bits = LIMB_BITS * a.arr.size() - normalization_shift(a.arr.back());
+  size_t limit = std::min<size_t>(std::max<size_t>(8 * bits, 1024),
+                                  SMALL_PRIME_LIMIT);
+  size_t groups = 0;
+  while (groups < s.products.size() &&
+         s.primes[s.first[groups + 1] - 1] < limit) {
+    groups++;
+  }
+  std::vector<uint32_t> residues =
+      small_prime_residues(a.arr.data(), a.arr.size(), groups);
+  for (size_t i = 0; i < residues.size(); i++) {
+    if (residues[i] == 0) {
+      return a.arr.size() == 1 && a.arr[0] == s.primes[i];
     }
   }
-  carry = static_cast<uint32_t>(static_cast<uint64_t>(get_complement()) +
-                                num_compl + carry);
-  if (carry != get_complement()) {
-    arr.push_back(carry);
-    is_neg = arr.back() >> 31;
+  uint64_t largest = s.primes[residues.size() - 1];
+  if (a < big_integer(largest * largest)) {
+    return true;
   }
-  remove_leading();
+  return big_integer::probable_prime(a, rounds);
 }
 
-template <typename F>
-void big_integer::add_with_func(F func, big_integer const& rhs,
-                                uint32_t carry) {
-  size_t new_size = std::max(arr.size(), rhs.arr.size());
-  resize(new_size, get_complement());
-  for (size_t i = 0; i < new_size; i++) {
-    uint64_t res = arr[i];
-    res += func(i < rhs.arr.size() ? rhs.arr[i] : rhs.get_complement());
-    res += carry;
-    arr[i] = static_cast<uint32_t>(res);
-    carry = res >> 32;
-  }
-  carry = static_cast<uint32_t>(static_cast<uint64_t>(get_complement()) +
-                                func(rhs.get_complement()) + carry);
-  if (carry != get_complement()) {
-    arr.push_back(carry);
-    is_neg = arr.back() >> 31;
+big_integer next_prime(big_integer const& a) {
+  if (a < 2) {
+    return 2;
   }
-  remove_leading();
-}
-
-big_integer& big_integer::operator-=(big_integer const& rhs) {
-  add_with_func([](uint32_t num) { return ~num; }, rhs, 1);
-  return *this;
-}
-
-big_integer& big_integer::operator*=(big_integer const& rhs) {
-  bool to_negate = is_neg ^ rhs.is_neg;
-  big_integer& top = (*this);
-  big_integer bot = rhs;
-  top.absolutify();
-  bot.absolutify();
-  std::vector<uint32_t> res;
-  res.resize(top.arr.size() + bot.arr.size(), 0);
-  uint32_t carry = 0;
-  for (size_t i = 0; i < top.arr.size(); i++) {
-    for (size_t k = 0; k < bot.arr.size() + 1; k++) {
-      uint64_t mul = static_cast<uint64_t>(top.arr[i]) *
-                         (k != bot.arr.size() ? bot.arr[k] : 0) +
-                     carry + res[i + k];
-      res[i + k] = static_cast<uint32_t>(mul);
-      carry = mul >> 32;
-    }
-  }
-  arr = res;
-  if (to_negate) {
-    negate();
+  big_integer start = a + ((a.arr[0] & 1) != 0 ? 2 : 1);
+  if (start < SMALL_PRIME_LIMIT) {
+    while (!is_probable_prime(start)) {
+      start += 2;
+    }
+    return start;
+  }
+  // the odd numbers start + 2 j, j < window, are sieved by all small primes
+  // at once; about ln(start) / 2 of them lie between consecutive primes
+  small_primes const& s = get_small_primes();
+  size_t bits =
+      LIMB_BITS * start.arr.size() - normalization_shift(start.arr.back());
+  size_t window = std::max<size_t>(bits, 64);
+  std::vector<bool> sieve(window);
+  for (;; start += big_integer(2 * window)) {
+    std::vector<uint32_t> residues = small_prime_residues(
+        start.arr.data(), start.arr.size(), s.products.size());
+    std::fill(sieve.begin(), sieve.end(), false);
+    for (size_t i = 0; i < residues.size(); i++) {
+      uint64_t p = s.primes[i];
+      // start + 2 j = 0 mod p for j = -start / 2 mod p
+      for (uint64_t j = (p - residues[i]) % p * ((p + 1) / 2) % p; j < window;
+           j += p) {
+        sieve[j] = true;
+      }
+    }
+    for (size_t j = 0; j < window; j++) {
+      if (!sieve[j]) {
+        big_integer candidate = start + big_integer(2 * j);
+        if (candidate < big_integer(uint64_t(SMALL_PRIME_LIMIT) *
+                                    SMALL_PRIME_LIMIT) ||
+            big_integer::probable_prime(candidate, 0)) {
+          return candidate;
+        }
+      }
+    }
   }
-  return remove_leading();
 }
 
-big_integer& big_integer::small_mul(uint32_t rhs) {
-  absolutify();
-  uint32_t carry = 0;
-  for (unsigned int& i : arr) {
-    uint64_t res = static_cast<uint64_t>(i) * rhs + carry;
-    i = static_cast<uint32_t>(res);
-    carry = res >> 32;
+// a[0, n) holds `total` limbs; the split balances the limbs of both halves
+big_integer big_integer::product_tree(big_integer const* a, size_t n,
+                                      size_t total) {
+  if (n == 1) {
+    return a[0];
   }
-  if (carry) {
-    arr.push_back(carry);
+  size_t mid = 0;
+  size_t left = 0;
+  do {
+    left += a[mid++].arr.size();
+  } while (mid < n - 1 && 2 * left < total);
+  if (total >= thresholds.parallel_product) {
+    big_integer lhs;
+    big_integer rhs;
+    run_parallel(2, [&](size_t i) {
+      if (i == 0) {
+        lhs = product_tree(a, mid, left);
+      } else {
+        rhs = product_tree(a + mid, n - mid, total - left);
+      }
+    });
+    return lhs * rhs;
   }
-  return remove_leading();
+  return product_tree(a, mid, left) *
+         product_tree(a + mid, n - mid, total - left);
 }
 
-big_integer& big_integer::operator/=(big_integer const& rhs) {
-  knut_div(rhs, DivType::Quot);
-  return *this;
+void big_integer::set_threads(size_t n) {
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  pool_threads = n;
+  pool.reset();
 }
 
-big_integer& big_integer::operator%=(big_integer const& rhs) {
-  knut_div(rhs, DivType::Remainder);
-  return *this;
+size_t big_integer::threads() {
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  return pool_threads == 0 ? default_threads() : pool_threads;
 }
 
-void big_integer::knut_div(const big_integer& rhs, DivType type) {
-  if (rhs == 0) {
-    throw std::invalid_argument("big_integer division by zero");
-  }
-  if (rhs == 1) {
-    if (type == DivType::Remainder) {
-      (*this) = 0;
-    }
-    return;
-  }
-  if (&rhs == this) {
-    (*this) = type == DivType::Quot ? 1 : 0;
-    return;
+void big_integer::release_scratch() {
+  thread_arena<limb_t>().release();
+  thread_arena<uint32_t>().release();
+}
+
+big_integer product(std::vector<big_integer> const& factors) {
+  if (factors.empty()) {
+    return 1;
   }
-  if (rhs.arr.size() > arr.size()) {
-    if (type == DivType::Quot) {
-      *this = 0;
-    }
-    return;
+  size_t total = 0;
+  for (big_integer const& f : factors) {
+    total += f.arr.size();
   }
-  bool was_neg = is_neg;
-  bool res_neg = (is_neg ^ rhs.is_neg);
-  (*this).absolutify();
-  big_integer v = rhs;
-  v.absolutify();
-  size_t n = v.arr.size();
-  if (n == 1) {
-    uint32_t rem = div_with_rem(v.arr.back());
-    if (type == DivType::Remainder) {
-      *this = rem;
-      if (was_neg) {
-        negate();
+  return big_integer::product_tree(factors.data(), factors.size(), total);
+}
+
+namespace {
+// the product of p^exps[p] over all primes p, exps[p] = 0 for composite p:
+// the odd prime powers are packed into limbs for product(), the power of
+// two becomes a shift
+big_integer prime_power_product(std::vector<int> const& exps) {
+  std::vector<big_integer> leaves;
+  limb_t acc = 1;
+  for (size_t p = 3; p < exps.size(); p += 2) {
+    for (int i = 0; i < exps[p]; i++) {
+      if (acc > std::numeric_limits<limb_t>::max() / p) {
+        leaves.emplace_back(acc);
+        acc = 1;
       }
-      return;
+      acc *= static_cast<limb_t>(p);
     }
-    if (res_neg) {
-      negate();
-    }
-    return;
   }
-  uint64_t b = std::numeric_limits<uint32_t>::max() + static_cast<uint64_t>(1);
-  uint32_t m = arr.size() - n;
-  big_integer q;
-  q.resize(m + 1, 0);
-  auto d = static_cast<uint32_t>(b / (static_cast<uint64_t>(v.arr.back()) + 1));
-  small_mul(d);
-  v.small_mul(d);
-  (*this).resize(m + n + 1, 0);
-
-  for (int64_t j = m; j >= 0; j--) {
-    uint32_t q_ = get_trialed_quot(b, j, n, v);
-    uint32_t carry_u = 0;
-    sub_from_current_prefix(n, v, q_, j, carry_u);
-    q.arr[j] = q_;
-    sub_q_if_overflows(n, j, carry_u, q, v);
-  }
-  if (type == DivType::Quot) {
-    if (res_neg) {
-      q.negate();
-    }
-    (*this) = q;
-  } else {
-    div_with_rem(d);
-    if (was_neg) {
-      negate();
-    }
+  leaves.emplace_back(acc);
+  return product(leaves) << (exps.size() > 2 ? exps[2] : 0);
+}
+
+// exponent of the prime p in n!, Legendre's formula
+int factorial_exp(int n, int p) {
+  int res = 0;
+  for (int m = n / p; m > 0; m /= p) {
+    res += m;
   }
-  remove_leading();
+  return res;
 }
 
-void big_integer::sub_q_if_overflows(size_t n, int64_t j, uint32_t carry_u,
-                                     big_integer& q, big_integer& v) {
-  if (carry_u > 0) {
-    q.arr[j]--;
-    carry_u = 0;
-    for (size_t i = 0; i <= n; i++) {
-      uint64_t cur = (i != n ? v.arr[i] : 0) + carry_u + arr[j + i];
-      carry_u = cur >> 32;
-      arr[j + i] = static_cast<uint32_t>(cur);
+// exps[p] = exponent of the prime p in n! / (k! l!) for k + l <= n
+std::vector<int> quotient_exps(int n, int k, int l) {
+  std::vector<int> exps(static_cast<size_t>(n) + 1, 0);
+  std::vector<bool> composite(exps.size());
+  for (size_t p = 2; p < exps.size(); p++) {
+    if (composite[p]) {
+      continue;
     }
+    for (size_t q = p * p; q < exps.size(); q += p) {
+      composite[q] = true;
+    }
+    int pi = static_cast<int>(p);
+    exps[p] = factorial_exp(n, pi) - factorial_exp(k, pi) -
+              factorial_exp(l, pi);
   }
+  return exps;
 }
+} // namespace
 
-void big_integer::sub_from_current_prefix(size_t n, big_integer& v, uint32_t q_,
-                                          int64_t j, uint32_t& carry_u) {
-  uint32_t carry_v = 0;
-  for (size_t i = 0; i <= n; i++) {
-    uint64_t cur_v =
-        (i != n ? v.arr[i] : 0) * static_cast<uint64_t>(q_) + carry_v + carry_u;
-    carry_v = cur_v >> 32;
-    auto actual = static_cast<uint32_t>(cur_v);
-    if (arr[j + i] < actual) {
-      carry_u = 1;
-    } else {
-      carry_u = 0;
-    }
-    arr[j + i] -= actual;
+big_integer factorial(int n) {
+  if (n < 0) {
+    throw std::invalid_argument("factorial argument has to be non-negative");
   }
+  return prime_power_product(quotient_exps(n, 0, 0));
 }
 
-uint32_t big_integer::get_trialed_quot(uint64_t b, int64_t j, size_t n,
-                                       big_integer& v) {
-  uint32_t q_ =
-      (static_cast<uint64_t>(arr[j + n]) * b + arr[j + n - 1]) / v.arr.back();
-  uint64_t r_ =
-      (static_cast<uint64_t>(arr[j + n]) * b + arr[j + n - 1]) % v.arr.back();
-  if (q_ == b ||
-      static_cast<uint64_t>(q_) * v.arr[n - 2] > (b * r_ + arr[j + n - 2])) {
-    q_--;
-    r_ += v.arr[n - 1];
-    if (r_ < b) {
-      if (q_ == b || static_cast<uint64_t>(q_) * v.arr[n - 2] >
-                         (b * r_ + arr[j + n - 2])) {
-        q_--;
-      }
-    }
+big_integer binomial(int n, int k) {
+  if (n < 0) {
+    throw std::invalid_argument("binomial argument has to be non-negative");
+  }
+  if (k < 0 || k > n) {
+    return 0;
   }
-  return q_;
+  return prime_power_product(quotient_exps(n, k, n - k));
 }
 
+// Bitwise operations act on the infinite two's complement expansions. Both
+// operands and the result are converted limb by limb on the fly: one limb
+// above the longer operand holds nothing but sign bits.
 template <typename F>
 void big_integer::abstract_bit_operation(F func, const big_integer& rhs) {
-  size_t new_size = std::max(arr.size(), rhs.arr.size());
-  resize(new_size, get_complement());
+  if (&rhs == this) {
+    big_integer copy = rhs;
+    abstract_bit_operation(func, copy);
+    return;
+  }
+  bool res_neg = func(limb_t(is_neg), limb_t(rhs.is_neg)) != 0;
+  limb_t mask_a = 0 - limb_t(is_neg);
+  limb_t mask_b = 0 - limb_t(rhs.is_neg);
+  limb_t mask_r = 0 - limb_t(res_neg);
+  limb_t carry_a = is_neg;
+  limb_t carry_b = rhs.is_neg;
+  limb_t carry_r = res_neg;
+  size_t new_size = std::max(arr.size(), rhs.arr.size()) + 1;
+  resize(new_size, 0);
   for (size_t i = 0; i < new_size; i++) {
-    arr[i] =
-        func(arr[i], (i < rhs.arr.size() ? rhs.arr[i] : rhs.get_complement()));
+    limb_t a = (arr[i] ^ mask_a) + carry_a;
+    carry_a = (a < carry_a ? 1 : 0);
+    limb_t b = (i < rhs.arr.size() ? rhs.arr[i] : 0) ^ mask_b;
+    b += carry_b;
+    carry_b = (b < carry_b ? 1 : 0);
+    limb_t r = (func(a, b) ^ mask_r) + carry_r;
+    carry_r = (r < carry_r ? 1 : 0);
+    arr[i] = r;
   }
-  is_neg = func(is_neg, rhs.is_neg) > 0;
+  is_neg = res_neg;
   remove_leading();
 }
 
 big_integer& big_integer::operator&=(big_integer const& rhs) {
-  abstract_bit_operation([](int a, int b) { return a & b; }, rhs);
+  abstract_bit_operation([](limb_t a, limb_t b) { return a & b; }, rhs);
   return *this;
 }
 
 big_integer& big_integer::operator|=(big_integer const& rhs) {
-  abstract_bit_operation([](int a, int b) { return a | b; }, rhs);
+  abstract_bit_operation([](limb_t a, limb_t b) { return a | b; }, rhs);
   return *this;
 }
 
 big_integer& big_integer::operator^=(big_integer const& rhs) {
-  abstract_bit_operation([](int a, int b) { return a ^ b; }, rhs);
+  abstract_bit_operation([](limb_t a, limb_t b) { return a ^ b; }, rhs);
   return *this;
 }
 
 big_integer& big_integer::operator<<=(int rhs) {
-  int offset = rhs / 32;
-  int rem = rhs % 32;
+  if (arr.empty()) {
+    return *this;
+  }
+  int offset = rhs / LIMB_BITS;
+  int rem = rhs % LIMB_BITS;
   size_t new_size = arr.size() + offset + 1;
   resize(new_size, 0);
-  uint32_t carry = get_complement();
+  limb_t carry = 0;
   for (int64_t i = new_size - 1; i > offset; i--) {
-    uint64_t res = arr[i - offset - 1];
-    res >>= 32 - rem;
-    res += (carry << rem);
-    arr[i] = static_cast<uint32_t>(res);
-    carry = arr[i - offset - 1];
+    limb_t cur = arr[i - offset - 1];
+    arr[i] = carry << rem;
+    if (rem != 0) {
+      arr[i] |= cur >> (LIMB_BITS - rem);
+    }
+    carry = cur;
   }
   arr[offset] = carry << rem;
   for (int64_t i = offset - 1; i >= 0; i--) {
@@ -381,25 +2874,40 @@ big_integer& big_integer::operator<<=(int rhs) {
   return remove_leading();
 }
 
+// rounds towards negative infinity like the two's complement shift: the
+// magnitude of a negative value is rounded up
 big_integer& big_integer::operator>>=(int rhs) {
-  if (rhs >= 32 * arr.size()) {
-    arr.erase(arr.begin(), arr.end());
-    arr.push_back(get_complement());
+  bool round_up = false;
+  if (rhs >= LIMB_BITS * arr.size()) {
+    round_up = !arr.empty();
+    arr.clear();
   } else {
-    int offset = rhs / 32;
-    int rem = rhs % 32;
+    int offset = rhs / LIMB_BITS;
+    int rem = rhs % LIMB_BITS;
+    if (is_neg) {
+      for (int i = 0; i < offset; i++) {
+        round_up = round_up || arr[i] != 0;
+      }
+      round_up = round_up ||
+                 (rem != 0 && (arr[offset] << (LIMB_BITS - rem)) != 0);
+    }
     size_t new_size = arr.size() - offset;
-    for (uint32_t i = 0; i < new_size - 1; i++) {
+    for (size_t i = 0; i + 1 < new_size; i++) {
       arr[i] = arr[i + offset] >> rem;
-      arr[i] += (arr[i + offset + 1] % (1 << rem)) << (32 - rem);
+      if (rem != 0) {
+        arr[i] += arr[i + offset + 1] << (LIMB_BITS - rem);
+      }
     }
     arr[new_size - 1] = arr.back() >> rem;
-    arr[new_size - 1] += (get_complement() % (1 << rem)) << (32 - rem);
-    for (uint32_t i = new_size; i < arr.size(); i++) {
-      arr[i] = get_complement();
-    }
+    arr.resize(new_size);
   }
-  return remove_leading();
+  bool round_neg = is_neg && round_up;
+  remove_leading();
+  if (round_neg) {
+    limb_t one = 1;
+    add_magnitude(&one, 1, true);
+  }
+  return *this;
 }
 
 big_integer big_integer::operator+() const {
@@ -407,26 +2915,16 @@ big_integer big_integer::operator+() const {
 }
 
 big_integer big_integer::operator-() const {
-  if (*this == 0) {
-    return *this;
-  }
   big_integer copy = *this;
-  invert_all(copy);
-  copy.add_int(1);
+  copy.negate();
   return copy;
 }
 
-void big_integer::invert_all(big_integer& a) {
-  for (uint32_t& num : a.arr) {
-    num = ~num;
-  }
-  a.is_neg = !a.is_neg;
-}
 
+// ~x == -x - 1
 big_integer big_integer::operator~() const {
-  big_integer res = *this;
-  invert_all(res);
-  res.remove_leading();
+  big_integer res = -*this;
+  res.add_int(-1);
   return res;
 }
 
@@ -453,49 +2951,102 @@ big_integer big_integer::operator--(int) {
 }
 
 big_integer operator+(big_integer a, big_integer const& b) {
-  return a += b;
+  a += b;
+  return a;
 }
 
 big_integer operator-(big_integer a, big_integer const& b) {
-  return a -= b;
+  a -= b;
+  return a;
 }
 
-big_integer operator*(big_integer a, big_integer const& b) {
-  return a *= b;
+big_integer operator*(big_integer const& a, big_integer const& b) {
+  big_integer res;
+  size_t len = a.arr.size() + b.arr.size();
+  if (len > big_integer::INLINE_LIMBS) {
+    // one spare limb keeps a following addition from reallocating
+    res.arr.reserve(len + 1);
+  }
+  res.arr.resize(len, 0);
+  // for a * a the limb kernels see identical operands and square
+  mul_limbs(res.arr.data(), a.arr.data(), a.arr.size(), b.arr.data(),
+            b.arr.size());
+  res.is_neg = a.is_neg != b.is_neg;
+  res.remove_leading();
+  return res;
 }
 
 big_integer operator/(big_integer a, big_integer const& b) {
-  return a /= b;
+  a /= b;
+  return a;
 }
 
 big_integer operator%(big_integer a, big_integer const& b) {
-  return a %= b;
+  a %= b;
+  return a;
 }
 
 big_integer operator&(big_integer a, big_integer const& b) {
-  return a &= b;
+  a &= b;
+  return a;
 }
 
 big_integer operator|(big_integer a, big_integer const& b) {
-  return a |= b;
+  a |= b;
+  return a;
 }
 
 big_integer operator^(big_integer a, big_integer const& b) {
-  return a ^= b;
+  a ^= b;
+  return a;
 }
 
 big_integer operator<<(big_integer a, int b) {
-  return a <<= b;
+  a <<= b;
+  return a;
 }
 
 big_integer operator>>(big_integer a, int b) {
-  return a >>= b;
+  a >>= b;
+  return a;
+}
+
+big_integer operator+(big_integer const& a, big_integer&& b) {
+  b += a;
+  return std::move(b);
+}
+
+big_integer operator-(big_integer const& a, big_integer&& b) {
+  b.negate();
+  b += a;
+  return std::move(b);
+}
+
+big_integer operator-(big_integer&& a, big_integer&& b) {
+  a -= b;
+  return std::move(a);
+}
+
+big_integer operator&(big_integer const& a, big_integer&& b) {
+  b &= a;
+  return std::move(b);
+}
+
+big_integer operator|(big_integer const& a, big_integer&& b) {
+  b |= a;
+  return std::move(b);
+}
+
+big_integer operator^(big_integer const& a, big_integer&& b) {
+  b ^= a;
+  return std::move(b);
 }
 
 void big_integer::init_big(unsigned long long a) {
   while (a > 0) {
-    arr.push_back(static_cast<uint32_t>(a));
-    a >>= 32;
+    arr.push_back(static_cast<limb_t>(a));
+    a >>= LIMB_BITS / 2;
+    a >>= LIMB_BITS / 2;
   }
   remove_leading();
 }
@@ -520,19 +3071,8 @@ bool operator<=(big_integer const& a, big_integer const& b) {
   if (a.is_neg != b.is_neg) {
     return a.is_neg;
   }
-  size_t a_sz = a.arr.size();
-  size_t b_sz = b.arr.size();
-  if (a_sz < b_sz) {
-    return !a.is_neg;
-  } else if (a_sz > b_sz) {
-    return a.is_neg;
-  }
-  for (size_t i = a_sz; i >= 1; i--) {
-    if (a.arr[i - 1] != b.arr[i - 1]) {
-      return (a.arr[i - 1] <= b.arr[i - 1]);
-    }
-  }
-  return true;
+  int cmp = cmp_limbs(a.arr.data(), a.arr.size(), b.arr.data(), b.arr.size());
+  return a.is_neg ? cmp >= 0 : cmp <= 0;
 }
 
 bool operator>=(big_integer const& a, big_integer const& b) {
@@ -540,75 +3080,549 @@ bool operator>=(big_integer const& a, big_integer const& b) {
 }
 
 void big_integer::negate() {
-  invert_all(*this);
-  add_int(1);
+  is_neg = !is_neg && !arr.empty();
 }
 
 void big_integer::absolutify() {
-  if (is_neg) {
-    negate();
+  is_neg = false;
+}
+
+// the magnitude of *this gets divided, returns the remainder of it
+limb_t big_integer::div_with_rem(limb_t num) {
+  limb_t rem = 0;
+  for (size_t i = arr.size(); i >= 1; i--) {
+    double_limb_t cur = (static_cast<double_limb_t>(rem) << LIMB_BITS) + arr[i - 1];
+    arr[i - 1] = static_cast<limb_t>(cur / num);
+    rem = static_cast<limb_t>(cur % num);
+  }
+  remove_leading();
+  return rem;
+}
+
+namespace {
+
+// the lowest size digits of block to out[0, size)
+void write_block(limb_t block, uint32_t base, size_t size, char* out) {
+  if (base == 10) {
+    // a constant divisor turns into a multiplication
+    for (size_t i = size; i > 0; i--) {
+      out[i - 1] = static_cast<char>('0' + block % 10);
+      block /= 10;
+    }
+    return;
+  }
+  for (size_t i = size; i > 0; i--) {
+    out[i - 1] = DIGITS[block % base];
+    block /= base;
   }
 }
 
-// *this gets divided, returns remainder;
-uint32_t big_integer::div_with_rem(uint32_t num) {
-  uint32_t rem = 0;
-  bool prev_neg = is_neg;
-  absolutify();
-  size_t index = arr.size();
-  size_t last_index = index - 1;
-  while (index >= 1) {
-    uint64_t res = (static_cast<uint64_t>(rem) << 32) + arr[index - 1];
-    if (last_index != arr.size() - 1 || res >= num) {
-      arr[last_index--] = res / num;
+} // namespace
+
+char* big_integer::radix::write(limb_t* a, size_t n, size_t width,
+                                char* out) const {
+  // the blocks come from the lowest one and wait in scratch limbs
+  scratch_limbs blocks(n * LIMB_BITS / bits + 1);
+  size_t count = 0;
+  while (n > 0) {
+    blocks.data()[count++] = div_limbs_1(a, n, pow);
+    n = trimmed_size(a, n);
+  }
+  if (width != 0) {
+    out = std::fill_n(out, width - count * size, '0');
+  } else if (count > 0) {
+    limb_t top = blocks.data()[--count];
+    size_t len = 0;
+    for (limb_t rest = top; rest != 0; rest /= base) {
+      len++;
     }
-    rem = res % num;
-    index--;
+    write_block(top, base, len, out);
+    out += len;
   }
-  for (size_t i = last_index + 1; i < arr.size(); i++) {
-    std::swap(arr[i], arr[i - last_index - 1]);
+  while (count > 0) {
+    write_block(blocks.data()[--count], base, size, out);
+    out += size;
   }
-  for (size_t i = arr.size() - last_index - 1; i < arr.size(); i++) {
-    arr[i] = 0;
+  return out;
+}
+
+char* big_integer::radix::write_bits(limb_t const* a, size_t n,
+                                     char* out) const {
+  size_t total = n * LIMB_BITS - normalization_shift(a[n - 1]);
+  size_t digits = (total + digit_bits - 1) / digit_bits;
+  for (size_t i = 0; i < digits; i++) {
+    size_t pos = i * digit_bits;
+    int shift = static_cast<int>(pos % LIMB_BITS);
+    limb_t cur = a[pos / LIMB_BITS] >> shift;
+    if (shift > LIMB_BITS - digit_bits && pos / LIMB_BITS + 1 < n) {
+      cur |= a[pos / LIMB_BITS + 1] << (LIMB_BITS - shift);
+    }
+    out[digits - 1 - i] = DIGITS[cur & (base - 1)];
   }
-  if (prev_neg) {
-    negate();
+  return out + digits;
+}
+
+// pow^(2^k) shifted to the highest bit set, with its reciprocal once it is
+// long enough for Barrett division
+struct big_integer::power_divisor {
+  limb_t const* d;
+  size_t n;
+  int shift;
+  limb_t const* inv;
+};
+
+// writes the digits of x[0, n) < pow^(2^level), padded to size * 2^level of
+// them unless leading, and returns their end; x is consumed. pows[k] divides
+// by pow^(2^k).
+char* big_integer::write_digits(limb_t* x, size_t n, size_t level,
+                                radix const& r, power_divisor const* pows,
+                                char* out, bool leading) {
+  n = trimmed_size(x, n);
+  if (level == 0 || n < thresholds.radix_conversion) {
+    return r.write(x, n, leading ? 0 : r.size << level, out);
   }
-  remove_leading();
-  return rem;
+  power_divisor const& p = pows[level - 1];
+  if (p.n == 1) {
+    limb_t low = div_limbs_1(x, n, p.d[0] >> p.shift);
+    if (!leading || trimmed_size(x, n) != 0) {
+      out = write_digits(x, n, level - 1, r, pows, out, leading);
+      leading = false;
+    }
+    return write_digits(&low, 1, level - 1, r, pows, out, leading);
+  }
+  if (n < p.n) {
+    if (!leading) {
+      out = std::fill_n(out, r.size << (level - 1), '0');
+    }
+    return write_digits(x, n, level - 1, r, pows, out, leading);
+  }
+  // the quotient and the remainder of the normalized x stay in scratch
+  // limbs until both halves are written
+  size_t m = n - p.n;
+  size_t q_len = quotient_size(m, p.n, p.inv != nullptr);
+  scratch_limbs buf((n + 1) + q_len);
+  limb_t* u = buf.data();
+  limb_t* q = u + n + 1;
+  shl_limbs(u, x, n, p.shift);
+  div_normalized(q, u, m, p.d, p.n, p.inv);
+  shr_limbs(u, u, p.n, p.shift);
+  if (!leading || trimmed_size(q, q_len) != 0) {
+    out = write_digits(q, q_len, level - 1, r, pows, out, leading);
+    leading = false;
+  }
+  return write_digits(u, p.n, level - 1, r, pows, out, leading);
+}
+
+size_t big_integer::digits_needed(int base) const {
+  radix r(base);
+  if (arr.empty()) {
+    return 1;
+  }
+  size_t sign = is_neg ? 1 : 0;
+  size_t bits = arr.size() * LIMB_BITS - normalization_shift(arr.back());
+  if (r.digit_bits != 0) {
+    return sign + (bits + r.digit_bits - 1) / r.digit_bits;
+  }
+  // 2^(bits - 1) <= |*this| < 2^bits takes floor(bits * log_base(2)) + 1
+  // digits or one less; the margin keeps the rounding of the logarithm from
+  // dropping below that
+  double digits = static_cast<double>(bits) * std::log(2.0) /
+                  std::log(static_cast<double>(base));
+  return sign + static_cast<size_t>(digits * (1 + 1e-12)) + 1;
+}
+
+std::to_chars_result big_integer::to_chars(char* first, char* last,
+                                           int base) const {
+  radix r(base);
+  size_t room = last - first;
+  size_t needed = digits_needed(base);
+  if (room < needed) {
+    // past powers of two the estimate may be one over, a buffer one short
+    // holds the digits if the magnitude stays below base^(digits - 1)
+    size_t digits = needed - (is_neg ? 1 : 0);
+    if (room + 1 < needed || r.digit_bits != 0 || digits == 1) {
+      return {last, std::errc::value_too_large};
+    }
+    // base^(digits - 1) is at most base times the magnitude
+    size_t n = arr.size();
+    scratch_limbs bound(2 * (n + 2));
+    size_t len = power_limbs(bound.data(), bound.data() + n + 2, r.base,
+                             static_cast<unsigned>(digits - 1));
+    if (cmp_limbs(arr.data(), n, bound.data(), len) >= 0) {
+      return {last, std::errc::value_too_large};
+    }
+  }
+  if (arr.empty()) {
+    *first = '0';
+    return {first + 1, std::errc()};
+  }
+  if (is_neg) {
+    *first++ = '-';
+  }
+  size_t n = arr.size();
+  if (r.digit_bits != 0) {
+    return {r.write_bits(arr.data(), n, first), std::errc()};
+  }
+  if (n < thresholds.radix_conversion) {
+    // the magnitude is divided down in scratch limbs instead of a copy
+    scratch_limbs mag(n);
+    std::copy(arr.begin(), arr.end(), mag.data());
+    return {r.write(mag.data(), n, 0, first), std::errc()};
+  }
+  // the magnitude and the powers pow^(2^k) up to it live in scratch limbs;
+  // pow < 2^32 bounds the length of the k-th power, at least r.bits bits
+  // per block bound their number
+  size_t bits = n * LIMB_BITS - normalization_shift(arr.back());
+  size_t table = 0;
+  size_t longest = 1;
+  for (size_t k = 0; (static_cast<size_t>(r.bits) << k) <= bits; k++) {
+    longest = ((size_t(32) << k) + LIMB_BITS - 1) / LIMB_BITS;
+    table += 2 * (longest + 1);
+  }
+  scratch_limbs buf(n + table + 4 * longest);
+  limb_t* mag = buf.data();
+  limb_t* next = mag + n;
+  limb_t* cur = next + table;
+  limb_t* sqr = cur + 2 * longest;
+  std::copy(arr.begin(), arr.end(), mag);
+  power_divisor pows[std::numeric_limits<size_t>::digits];
+  size_t levels = 0;
+  cur[0] = r.pow;
+  size_t len = 1;
+  while (cmp_limbs(cur, len, mag, n) <= 0) {
+    power_divisor& p = pows[levels++];
+    p.shift = normalization_shift(cur[len - 1]);
+    shl_limbs(next, cur, len, p.shift);
+    p.d = next;
+    p.n = len;
+    p.inv = nullptr;
+    next += len + 1;
+    if (len >= std::max<size_t>(thresholds.newton_div, 2)) {
+      reciprocal_limbs(next, p.d, len);
+      p.inv = next;
+      next += len + 1;
+    }
+    mul_limbs(sqr, cur, len, cur, len);
+    len = trimmed_size(sqr, 2 * len);
+    std::swap(cur, sqr);
+  }
+  return {write_digits(mag, n, levels, r, pows, first, true), std::errc()};
+}
+
+std::from_chars_result from_chars(char const* first, char const* last,
+                                  big_integer& value, int base) {
+  if (base < 2 || base > 36) {
+    return {first, std::errc::invalid_argument};
+  }
+  big_integer::radix r(base);
+  char const* digits = (first != last && *first == '-' ? first + 1 : first);
+  char const* end = digits;
+  while (end != last && digit_value(*end) < r.base) {
+    end++;
+  }
+  if (end == digits) {
+    return {first, std::errc::invalid_argument};
+  }
+  value = big_integer::from_digits(digits, end - digits, r);
+  if (digits != first) {
+    value.negate();
+  }
+  return {end, std::errc()};
 }
 
 std::string to_string(big_integer const& a) {
-  if (a.arr.empty()) {
-    return "0";
+  return to_string(a, 10);
+}
+
+std::string to_string(big_integer const& a, int base) {
+  std::string res(a.digits_needed(base), '0');
+  res.resize(a.to_chars(&res[0], &res[0] + res.size(), base).ptr -
+             res.data());
+  return res;
+}
+
+big_integer_parser::big_integer_parser(int base) : base(base) {
+  big_integer::radix r(base);
+  chunk = r.size * big_integer::thresholds.radix_conversion;
+  pending.reserve(chunk);
+}
+
+char const* big_integer_parser::feed(char const* first, char const* last) {
+  if (!started && first != last && *first == '-') {
+    neg = true;
+    started = true;
+    first++;
   }
-  std::string res;
-  big_integer copy = a;
-  copy.absolutify();
-  while (true) {
-    uint32_t rem = copy.div_with_rem(POW_10_BLOCK);
-    auto rem_len = static_cast<uint32_t>(log10(std::max(rem, 1u)) + 1);
-    res += std::to_string(rem);
-    std::string::iterator pos = res.begin();
-    std::advance(pos, res.length() - rem_len);
-    std::reverse(pos, res.end());
-    if (copy == 0) {
-      break;
+  for (; first != last && digit_value(*first) < static_cast<unsigned>(base);
+       first++) {
+    started = true;
+    pending.push_back(*first);
+    if (pending.size() == chunk) {
+      push_chunk();
     }
-    res.append(POW_10_BLOCK_SIZE - rem_len, '0');
   }
-  if (a.is_neg) {
-    res += '-';
+  return first;
+}
+
+bool big_integer_parser::has_digits() const {
+  return !pending.empty() || !values.empty();
+}
+
+// value of the pending digits, the stack merges equal levels like a binary
+// counter increment
+void big_integer_parser::push_chunk() {
+  values.push_back(
+      big_integer::from_digits(pending.data(), pending.size(),
+                               big_integer::radix(base)));
+  levels.push_back(0);
+  pending.clear();
+  size_t n = values.size();
+  while (n >= 2 && levels[n - 2] == levels[n - 1]) {
+    size_t k = levels[n - 1];
+    scale(values[n - 2], k);
+    values[n - 2] += values[n - 1];
+    levels[n - 2]++;
+    values.pop_back();
+    levels.pop_back();
+    n--;
+  }
+}
+
+// x *= base^(chunk * 2^k)
+void big_integer_parser::scale(big_integer& x, size_t k) {
+  big_integer::radix r(base);
+  if (r.digit_bits != 0) {
+    x <<= static_cast<int>(r.digit_bits * (chunk << k));
+    return;
   }
-  std::reverse(res.begin(), res.end());
+  if (pows.empty()) {
+    pows.push_back(power(r.pow, static_cast<unsigned>(chunk / r.size)));
+  }
+  while (pows.size() <= k) {
+    pows.push_back(sqr(pows.back()));
+  }
+  x *= pows[k];
+}
+
+big_integer big_integer_parser::finish() {
+  if (!has_digits()) {
+    throw std::invalid_argument("No digits to parse");
+  }
+  big_integer::radix r(base);
+  big_integer res = pending.empty()
+                        ? big_integer()
+                        : big_integer::from_digits(pending.data(),
+                                                   pending.size(), r);
+  // the deeper a block lies on the stack the more significant it is; below
+  // it come all blocks above it and the pending digits
+  size_t low_digits = pending.size();
+  big_integer low_scale;
+  if (r.digit_bits == 0) {
+    low_scale = power(r.base, static_cast<unsigned>(low_digits));
+  }
+  for (size_t i = values.size(); i-- > 0;) {
+    if (r.digit_bits != 0) {
+      values[i] <<= static_cast<int>(r.digit_bits * low_digits);
+      low_digits += chunk << levels[i];
+    } else {
+      values[i] *= low_scale;
+      if (i > 0) {
+        scale(low_scale, levels[i]);
+      }
+    }
+    res += values[i];
+  }
+  if (neg) {
+    res.negate();
+  }
+  *this = big_integer_parser(base);
   return res;
 }
 
+std::istream& operator>>(std::istream& s, big_integer& a) {
+  std::istream::sentry guard(s);
+  if (!guard) {
+    return s;
+  }
+  // the characters go to the parser in pieces, the stream keeps the first
+  // one that is not part of the number
+  big_integer_parser parser;
+  std::streambuf* buf = s.rdbuf();
+  char piece[4096];
+  size_t len = 0;
+  for (int c = buf->sgetc();; c = buf->snextc()) {
+    if (c == std::char_traits<char>::eof()) {
+      s.setstate(std::ios_base::eofbit);
+      break;
+    }
+    auto ch = static_cast<char>(c);
+    bool sign = (ch == '-' && len == 0 && !parser.has_digits());
+    if (digit_value(ch) >= 10 && !sign) {
+      break;
+    }
+    piece[len++] = ch;
+    if (len == sizeof(piece)) {
+      parser.feed(piece, piece + len);
+      len = 0;
+    }
+  }
+  parser.feed(piece, piece + len);
+  if (!parser.has_digits()) {
+    s.setstate(std::ios_base::failbit);
+    return s;
+  }
+  a = parser.finish();
+  return s;
+}
+
 std::ostream& operator<<(std::ostream& s, big_integer const& a) {
   return s << to_string(a);
 }
 
 void swap(big_integer& a, big_integer& b) {
-  std::swap(a.arr, b.arr);
+  a.arr.swap(b.arr);
   std::swap(a.is_neg, b.is_neg);
 }
+
+namespace {
+
+const size_t LIMB_BYTES = LIMB_BITS / 8;
+
+bool is_power_of_two(limb_t const* a, size_t n) {
+  return std::all_of(a, a + n - 1, [](limb_t x) { return x == 0; }) &&
+         (a[n - 1] & (a[n - 1] - 1)) == 0;
+}
+
+} // namespace
+
+size_t export_size(big_integer const& a, sign_encoding enc) {
+  size_t n = a.arr.size();
+  if (n == 0) {
+    return 1;
+  }
+  size_t bits = n * LIMB_BITS - normalization_shift(a.arr.back());
+  // -2^k needs no more bits than 2^k - 1
+  if (a.is_neg && enc == sign_encoding::twos_complement &&
+      is_power_of_two(a.arr.data(), n)) {
+    bits--;
+  }
+  // one more bit for the sign
+  return bits / 8 + 1;
+}
+
+void export_bytes(big_integer const& a, uint8_t* out, byte_order order,
+                  sign_encoding enc) {
+  size_t len = export_size(a, enc);
+  size_t n = a.arr.size();
+  bool complement = a.is_neg && enc == sign_encoding::twos_complement;
+  limb_t carry = 1;
+  for (size_t i = 0; i < len; i += LIMB_BYTES) {
+    limb_t cur = i / LIMB_BYTES < n ? a.arr[i / LIMB_BYTES] : 0;
+    if (complement) {
+      cur = ~cur + carry;
+      carry = (carry != 0 && cur == 0 ? 1 : 0);
+    }
+    for (size_t j = 0; j < LIMB_BYTES && i + j < len; j++) {
+      out[i + j] = static_cast<uint8_t>(cur >> (8 * j));
+    }
+  }
+  if (a.is_neg && enc == sign_encoding::magnitude) {
+    out[len - 1] |= 0x80;
+  }
+  if (order == byte_order::big) {
+    std::reverse(out, out + len);
+  }
+}
+
+std::vector<uint8_t> export_bytes(big_integer const& a, byte_order order,
+                                  sign_encoding enc) {
+  std::vector<uint8_t> res(export_size(a, enc));
+  export_bytes(a, res.data(), order, enc);
+  return res;
+}
+
+big_integer import_bytes(uint8_t const* data, size_t len, byte_order order,
+                         sign_encoding enc) {
+  big_integer res;
+  if (len == 0) {
+    return res;
+  }
+  size_t n = (len + LIMB_BYTES - 1) / LIMB_BYTES;
+  res.arr.resize(n, 0);
+  for (size_t i = 0; i < len; i++) {
+    uint8_t byte = order == byte_order::little ? data[i] : data[len - 1 - i];
+    res.arr[i / LIMB_BYTES] |= static_cast<limb_t>(byte)
+                               << (8 * (i % LIMB_BYTES));
+  }
+  int sign_pos = static_cast<int>(8 * ((len - 1) % LIMB_BYTES) + 7);
+  limb_t sign_bit = static_cast<limb_t>(1) << sign_pos;
+  if ((res.arr[n - 1] & sign_bit) != 0) {
+    if (enc == sign_encoding::magnitude) {
+      res.arr[n - 1] &= ~sign_bit;
+    } else {
+      // sign extension of the top limb, then the magnitude
+      if (sign_pos + 1 < LIMB_BITS) {
+        res.arr[n - 1] |= ~static_cast<limb_t>(0) << (sign_pos + 1);
+      }
+      negate_limbs(res.arr.data(), n);
+    }
+    res.is_neg = true;
+  }
+  return res.remove_leading();
+}
+
+void write_varint(big_integer const& a, std::vector<uint8_t>& out) {
+  big_integer z = a;
+  z.absolutify();
+  z <<= 1;
+  if (a.is_neg) {
+    --z;
+  }
+  size_t n = z.arr.size();
+  if (n == 0) {
+    out.push_back(0);
+    return;
+  }
+  size_t bits = n * LIMB_BITS - normalization_shift(z.arr.back());
+  for (size_t pos = 0; pos < bits; pos += 7) {
+    size_t i = pos / LIMB_BITS;
+    int shift = static_cast<int>(pos % LIMB_BITS);
+    limb_t cur = z.arr[i] >> shift;
+    if (shift > LIMB_BITS - 7 && i + 1 < n) {
+      cur |= z.arr[i + 1] << (LIMB_BITS - shift);
+    }
+    auto byte = static_cast<uint8_t>(cur & 0x7f);
+    out.push_back(pos + 7 < bits ? byte | 0x80 : byte);
+  }
+}
+
+big_integer read_varint(uint8_t const*& first, uint8_t const* last) {
+  uint8_t const* end = first;
+  while (end != last && (*end & 0x80) != 0) {
+    end++;
+  }
+  if (end == last) {
+    throw std::invalid_argument("Truncated varint");
+  }
+  big_integer z;
+  z.arr.resize(7 * (end - first + 1) / LIMB_BITS + 1, 0);
+  for (size_t pos = 0; first != end + 1; first++, pos += 7) {
+    size_t i = pos / LIMB_BITS;
+    int shift = static_cast<int>(pos % LIMB_BITS);
+    limb_t cur = *first & 0x7f;
+    z.arr[i] |= cur << shift;
+    if (shift > LIMB_BITS - 7) {
+      z.arr[i + 1] |= cur >> (LIMB_BITS - shift);
+    }
+  }
+  z.remove_leading();
+  bool neg = !z.arr.empty() && (z.arr[0] & 1) != 0;
+  if (neg) {
+    ++z;
+  }
+  z >>= 1;
+  if (neg) {
+    z.negate();
+  }
+  return z;
+}
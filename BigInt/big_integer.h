@@ -1,12 +1,80 @@
 #pragma once
 
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
 #include <iosfwd>
 #include <string>
 #include <vector>
 
+#include "limb_vector.h"
+
+// Width of a limb. 64-bit limbs need a 128-bit integer type for intermediate
+// products; every translation unit has to see the same value.
+#ifndef BIG_INTEGER_LIMB_BITS
+#ifdef __SIZEOF_INT128__
+#define BIG_INTEGER_LIMB_BITS 64
+#else
+#define BIG_INTEGER_LIMB_BITS 32
+#endif
+#endif
+
+// Operand sizes (in limbs) at which an operation switches to the next
+// algorithm tier. Multiplication sizes refer to the shorter operand, division
+// sizes to the divisor, gcd sizes to the longer operand, product tree sizes
+// to the result of a subtree.
+struct big_integer_thresholds {
+#if BIG_INTEGER_LIMB_BITS == 64
+  size_t karatsuba_mul{32};
+  size_t toom3_mul{160};
+  size_t ntt_mul{14000};
+  size_t newton_div{1000};
+  size_t radix_conversion{40};
+  size_t half_gcd{2000};
+  // where the half-gcd recursion bottoms out in Lehmer steps
+  size_t half_gcd_base{200};
+  // Toom-3 products this large compute their five parts in parallel (the
+  // transform multiplication always does), subtrees of product() this large
+  // their two halves
+  size_t parallel_mul{1000};
+  size_t parallel_product{4000};
+#else
+  size_t karatsuba_mul{32};
+  size_t toom3_mul{160};
+  size_t ntt_mul{2500};
+  size_t newton_div{320};
+  size_t radix_conversion{40};
+  size_t half_gcd{3000};
+  size_t half_gcd_base{400};
+  size_t parallel_mul{2000};
+  size_t parallel_product{8000};
+#endif
+};
+
+// Binary forms of a value. little starts from the least significant byte,
+// big from the most significant one. twos_complement is the infinite two's
+// complement expansion cut to the shortest length that keeps the sign bit;
+// magnitude is the shortest magnitude with one more leading bit for the
+// sign. Zero is a single zero byte in both.
+enum class byte_order { little, big };
+enum class sign_encoding { twos_complement, magnitude };
+
+struct big_integer_divisor;
+struct big_integer_montgomery;
+
 struct big_integer {
+#if BIG_INTEGER_LIMB_BITS == 64
+  using limb_t = uint64_t;
+#else
+  using limb_t = uint32_t;
+#endif
+  static constexpr int LIMB_BITS = BIG_INTEGER_LIMB_BITS;
+  // values up to 128 bits are kept without a heap allocation
+  static constexpr size_t INLINE_LIMBS = 128 / LIMB_BITS;
+
   big_integer();
   big_integer(big_integer const& other);
+  big_integer(big_integer&& other) noexcept;
   big_integer(int a);
   big_integer(unsigned int a);
   big_integer(long a);
@@ -14,9 +82,16 @@ struct big_integer {
   big_integer(long long a);
   big_integer(unsigned long long a);
   explicit big_integer(std::string const& str);
+  // digits of a base in [2, 36] after an optional '-', letters in either
+  // case; throws std::invalid_argument for anything else
+  big_integer(std::string const& str, int base);
+  // the magnitude from limbs starting at the least significant one, e.g.
+  // straight out of a mapped file written from limb_data()
+  big_integer(limb_t const* first, limb_t const* last, bool negative = false);
   ~big_integer();
 
   big_integer& operator=(big_integer const& other);
+  big_integer& operator=(big_integer&& other) noexcept;
 
   big_integer& operator+=(big_integer const& rhs);
   big_integer& operator-=(big_integer const& rhs);
@@ -48,54 +123,215 @@ struct big_integer {
   friend bool operator<=(big_integer const& a, big_integer const& b);
   friend bool operator>=(big_integer const& a, big_integer const& b);
 
+  friend big_integer operator*(big_integer const& a, big_integer const& b);
+
+  friend big_integer gcd(big_integer const& a, big_integer const& b);
+  friend big_integer xgcd(big_integer const& a, big_integer const& b,
+                          big_integer& s, big_integer& t);
+  friend big_integer iroot(big_integer const& a, int k, big_integer& rem);
+  friend bool is_probable_prime(big_integer const& a, int rounds);
+  friend big_integer next_prime(big_integer const& a);
+  friend big_integer product(std::vector<big_integer> const& factors);
+
   friend std::string to_string(big_integer const& a);
+  friend std::string to_string(big_integer const& a, int base);
+  friend std::from_chars_result from_chars(char const* first,
+                                           char const* last,
+                                           big_integer& value, int base);
+
+  // room to_chars needs in base, the length of the digits and sign or one
+  // more
+  size_t digits_needed(int base = 10) const;
+  // the digits of to_string(*this, base), fails with value_too_large if
+  // they do not fit into [first, last). The work is done in the scratch area
+  // of the calling thread, repeated calls allocate nothing.
+  std::to_chars_result to_chars(char* first, char* last, int base = 10) const;
   friend void swap(big_integer& a, big_integer& b);
 
+  friend size_t export_size(big_integer const& a, sign_encoding enc);
+  friend void export_bytes(big_integer const& a, uint8_t* out,
+                           byte_order order, sign_encoding enc);
+  friend big_integer import_bytes(uint8_t const* data, size_t len,
+                                  byte_order order, sign_encoding enc);
+  friend void write_varint(big_integer const& a, std::vector<uint8_t>& out);
+  friend big_integer read_varint(uint8_t const*& first, uint8_t const* last);
+
+  // the magnitude without leading zero limbs, valid until *this changes
+  limb_t const* limb_data() const;
+  size_t limb_count() const;
+  bool is_negative() const;
+
   void absolutify();
 
   void negate();
 
+  // *this += a * b and *this -= a * b, accumulated straight into the limbs
+  // of *this without a temporary for the product
+  big_integer& addmul(big_integer const& a, big_integer const& b);
+  big_integer& submul(big_integer const& a, big_integer const& b);
+  big_integer& addmul_1(big_integer const& a, limb_t b);
+  big_integer& submul_1(big_integer const& a, limb_t b);
+
+  static big_integer_thresholds thresholds;
+
+  // threads the parallel parts of an operation are spread over, the calling
+  // one included; 1 keeps all work on the calling thread, 0 (the default)
+  // uses one per core. Operations already running keep their threads.
+  static void set_threads(size_t n);
+  static size_t threads();
+
+  // temporaries of the algorithms come from a per-thread scratch area that
+  // keeps its peak size; this frees the one of the calling thread
+  static void release_scratch();
+
 private:
-  std::vector<uint32_t> arr;
+  friend struct big_integer_divisor;
+  friend struct big_integer_montgomery;
+  friend struct big_integer_parser;
+
+  // magnitude without leading zero limbs and its sign; zero is never
+  // negative
+  limb_vector<limb_t, INLINE_LIMBS> arr;
   bool is_neg{false};
   enum class DivType { Quot, Remainder };
 
   void add_int(int32_t num);
 
-  static void invert_all(big_integer& a);
-
   template <typename F>
   void abstract_bit_operation(F func, big_integer const& rhs);
 
-  template <typename F>
-  void add_with_func(F func, big_integer const& rhs, uint32_t carry);
+  void add_magnitude(limb_t const* b, size_t m, bool b_neg);
 
   big_integer& remove_leading();
 
   void init_big(unsigned long long a);
 
-  uint32_t get_complement() const;
+  limb_t div_with_rem(limb_t num);
 
-  uint32_t div_with_rem(uint32_t num);
-
-  void resize(size_t new_size, uint32_t val);
+  void resize(size_t new_size, limb_t val);
 
   void knut_div(big_integer const& rhs, DivType type);
 
-  uint32_t get_trialed_quot(uint64_t b, int64_t j, size_t n, big_integer& v);
+  big_integer& small_mul(limb_t rhs);
+
+  big_integer& fused_mul(big_integer const& a, big_integer const& b,
+                         bool subtract);
+
+  big_integer& fused_mul_1(big_integer const& a, limb_t b, bool subtract);
+
+  void accumulate_product(limb_t const* a, size_t n, limb_t const* b, size_t m,
+                          bool subtract);
+
+  static big_integer from_limbs(limb_t const* first, limb_t const* last);
+
+  struct radix;
+
+  static big_integer from_digits(char const* first, size_t len,
+                                 radix const& r);
+
+  static big_integer parse_digits(char const* first, size_t len,
+                                  radix const& r,
+                                  std::vector<big_integer> const& pows);
+
+  struct gcd_matrix;
 
-  void sub_from_current_prefix(size_t n, big_integer& v, uint32_t q_, int64_t j,
-                               uint32_t& carry_u);
+  static void euclid_step(big_integer& x, big_integer& y, gcd_matrix* m);
 
-  void sub_q_if_overflows(size_t n, int64_t j, uint32_t carry_u, big_integer& q,
-                          big_integer& v);
+  static void lehmer_reduce(big_integer& x, big_integer& y, size_t target,
+                            gcd_matrix* m);
 
-  big_integer& small_mul(uint32_t rhs);
+  static void half_gcd(big_integer& x, big_integer& y, size_t target,
+                       gcd_matrix* m);
+
+  static void gcd_reduce(big_integer& x, big_integer& y, gcd_matrix* m);
+
+  static bool probable_prime(big_integer const& n, int rounds);
+
+  static big_integer product_tree(big_integer const* a, size_t n,
+                                  size_t total);
+
+  struct power_divisor;
+
+  static char* write_digits(limb_t* x, size_t n, size_t level,
+                            radix const& r, power_divisor const* pows,
+                            char* out, bool leading);
+};
+
+// Repeated division by the same value: the normalization of the divisor and,
+// for long divisors, its Newton reciprocal are computed once. Results follow
+// operator/ and operator%.
+struct big_integer_divisor {
+  explicit big_integer_divisor(big_integer const& d);
+
+  big_integer div(big_integer const& a) const;
+  big_integer mod(big_integer const& a) const;
+  void divmod(big_integer const& a, big_integer& q, big_integer& r) const;
+
+private:
+  big_integer norm;
+  big_integer inv;
+  int shift{0};
+  bool neg{false};
+};
+
+// Exponentiation modulo a fixed odd modulus in Montgomery form: the setup is
+// paid once, every product is then reduced without a division. Results lie
+// in [0, |mod|).
+struct big_integer_montgomery {
+  explicit big_integer_montgomery(big_integer const& mod);
+
+  big_integer pow(big_integer const& base, big_integer const& exp) const;
+
+  // longer computations can stay in Montgomery form a * B^n mod |mod|: mul
+  // takes and returns that form, its arguments have to lie in [0, |mod|)
+  big_integer to_montgomery(big_integer const& a) const;
+  big_integer from_montgomery(big_integer const& a) const;
+  big_integer mul(big_integer const& a, big_integer const& b) const;
+
+private:
+  big_integer mod;
+  // B^2n and B^n mod |mod|, i.e. the Montgomery forms of B^n and 1, padded
+  // to the n limbs of mod
+  std::vector<big_integer::limb_t> r2;
+  std::vector<big_integer::limb_t> one;
+  big_integer::limb_t neg_inv{0};
+};
+
+// Digits that arrive in pieces, e.g. from a stream too large to hold as
+// text. Every chunk of thresholds.radix_conversion blocks is converted on its
+// own and the chunk values are merged pairwise like a binary counter, so the
+// pending work is a few values about as long as the result in binary.
+struct big_integer_parser {
+  explicit big_integer_parser(int base = 10);
+
+  // takes a '-' before the first digit and the digits of the base from
+  // [first, last), returns the first character that is neither
+  char const* feed(char const* first, char const* last);
+  bool has_digits() const;
+  // the value of the digits so far, the parser starts over; throws
+  // std::invalid_argument without a digit
+  big_integer finish();
+
+private:
+  void push_chunk();
+  void scale(big_integer& x, size_t k);
+
+  int base;
+  // digits per chunk
+  size_t chunk;
+  std::string pending;
+  bool neg{false};
+  bool started{false};
+  // merged chunks from the most significant one, values[i] spans
+  // chunk * 2^levels[i] digits; pows[k] = base^(chunk * 2^k)
+  std::vector<big_integer> values;
+  std::vector<size_t> levels;
+  std::vector<big_integer> pows;
 };
 
 big_integer operator+(big_integer a, big_integer const& b);
 big_integer operator-(big_integer a, big_integer const& b);
-big_integer operator*(big_integer a, big_integer const& b);
+big_integer operator*(big_integer const& a, big_integer const& b);
 big_integer operator/(big_integer a, big_integer const& b);
 big_integer operator%(big_integer a, big_integer const& b);
 
@@ -103,6 +339,18 @@ big_integer operator&(big_integer a, big_integer const& b);
 big_integer operator|(big_integer a, big_integer const& b);
 big_integer operator^(big_integer a, big_integer const& b);
 
+// the result is built in the storage of the temporary right operand;
+// a product always needs fresh storage, so operator* has no such overload
+big_integer operator+(big_integer const& a, big_integer&& b);
+big_integer operator-(big_integer const& a, big_integer&& b);
+
+big_integer operator&(big_integer const& a, big_integer&& b);
+big_integer operator|(big_integer const& a, big_integer&& b);
+big_integer operator^(big_integer const& a, big_integer&& b);
+
+// with both operands temporary the left one is reused, saving a negation
+big_integer operator-(big_integer&& a, big_integer&& b);
+
 big_integer operator<<(big_integer a, int b);
 big_integer operator>>(big_integer a, int b);
 
@@ -114,5 +362,76 @@ bool operator>(big_integer const& a, big_integer const& b);
 bool operator<=(big_integer const& a, big_integer const& b);
 bool operator>=(big_integer const& a, big_integer const& b);
 
+// same as a * a, which already takes the squaring path
+big_integer sqr(big_integer const& a);
+
+// base^exp mod |mod| in [0, |mod|) for exp >= 0; odd moduli go through
+// big_integer_montgomery
+big_integer powmod(big_integer const& base, big_integer const& exp,
+                   big_integer const& mod);
+
+// non-negative gcd, gcd(0, 0) = 0
+big_integer gcd(big_integer const& a, big_integer const& b);
+// also finds s, t with s a + t b = gcd(a, b); for b != 0 the cofactor s lies
+// in [0, |b| / gcd(a, b))
+big_integer xgcd(big_integer const& a, big_integer const& b, big_integer& s,
+                 big_integer& t);
+// a^-1 mod |mod| in [0, |mod|), throws if gcd(a, mod) != 1
+big_integer modinv(big_integer const& a, big_integer const& mod);
+
+// floor(sqrt(a)) for a >= 0, rem receives a - root^2
+big_integer isqrt(big_integer const& a);
+big_integer isqrt(big_integer const& a, big_integer& rem);
+// k-th root truncated toward zero, negative a only for odd k; rem receives
+// a - root^k
+big_integer iroot(big_integer const& a, int k);
+big_integer iroot(big_integer const& a, int k, big_integer& rem);
+
+// trial division by the primes below 2^16 (fewer for short a), then a
+// Baillie-PSW test: Miller-Rabin to base 2 and a strong Lucas test. rounds
+// adds Miller-Rabin rounds to pseudo-random bases. Negative a are not prime.
+bool is_probable_prime(big_integer const& a, int rounds = 0);
+// smallest probable prime greater than a
+big_integer next_prime(big_integer const& a);
+
+// product of all factors along a balanced tree, so that operands of similar
+// size get multiplied; the halves of large subtrees may run in parallel.
+// The empty product is 1.
+big_integer product(std::vector<big_integer> const& factors);
+// n! for n >= 0 and the binomial coefficient, 0 for k < 0 or k > n; both
+// multiply the prime powers of their factorization with product()
+big_integer factorial(int n);
+big_integer binomial(int n, int k);
+
+// bytes export_bytes writes for a, at least one
+size_t export_size(big_integer const& a, sign_encoding enc);
+// writes exactly export_size(a, enc) bytes to out
+void export_bytes(big_integer const& a, uint8_t* out, byte_order order,
+                  sign_encoding enc);
+std::vector<uint8_t> export_bytes(big_integer const& a, byte_order order,
+                                  sign_encoding enc);
+// any length is accepted, leading sign bytes included; no bytes are zero
+big_integer import_bytes(uint8_t const* data, size_t len, byte_order order,
+                         sign_encoding enc);
+
+// Zigzag LEB128: 2|a| for a >= 0 and 2|a| - 1 otherwise in groups of 7 bits
+// from the lowest one, the high bit set on every byte but the last. Values
+// in [-64, 64) take one byte. write_varint appends to out, read_varint
+// advances first past the value and throws on a truncated one.
+void write_varint(big_integer const& a, std::vector<uint8_t>& out);
+big_integer read_varint(uint8_t const*& first, uint8_t const* last);
+
 std::string to_string(big_integer const& a);
+// digits of a base in [2, 36] with lowercase letters; powers of two take one
+// pass over the bits, the other bases go through blocks of digits like
+// decimal does
+std::string to_string(big_integer const& a, int base);
+// an optional '-' and the longest run of digits of base after it, parsed
+// like std::from_chars: without any digit the result is invalid_argument and
+// value is left alone
+std::from_chars_result from_chars(char const* first, char const* last,
+                                  big_integer& value, int base = 10);
 std::ostream& operator<<(std::ostream& s, big_integer const& a);
+// skips whitespace and reads an optional '-' and decimal digits through a
+// big_integer_parser; failbit is set without a digit, a is then unchanged
+std::istream& operator>>(std::istream& s, big_integer& a);
@@ -0,0 +1,410 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "big_integer.h"
+
+// Integers of exactly Bits bits in inline limbs. Arithmetic wraps around
+// modulo 2^Bits like unsigned built-in types; Signed reads the top bit as
+// the sign of a two's complement. Division truncates toward zero, shifts and
+// bitwise operations act on the two's complement, both as for big_integer.
+// Every loop runs over a compile-time limb count, so short widths unroll
+// completely, and everything but the conversions is constexpr.
+template <size_t Bits, bool Signed = false>
+struct fixed_big_integer {
+  static_assert(Bits > 0, "fixed_big_integer needs at least one bit");
+
+  using limb_t = big_integer::limb_t;
+  static constexpr int LIMB_BITS = big_integer::LIMB_BITS;
+  static constexpr size_t LIMBS = (Bits + LIMB_BITS - 1) / LIMB_BITS;
+
+  constexpr fixed_big_integer() = default;
+
+  // a sign extended to Bits, higher bits are cut off
+  template <typename T,
+            typename = std::enable_if_t<std::is_integral<T>::value &&
+                                        !std::is_same<T, bool>::value>>
+  constexpr fixed_big_integer(T a) {
+    auto bits = static_cast<unsigned long long>(a);
+    limb_t fill = is_below_zero(a) ? ~static_cast<limb_t>(0) : 0;
+    for (size_t i = 0; i < LIMBS; i++) {
+      size_t shift = i * LIMB_BITS;
+      limbs[i] = shift < 64 ? static_cast<limb_t>(bits >> shift) : fill;
+    }
+    normalize();
+  }
+
+  // the lowest Bits of the two's complement of a
+  explicit fixed_big_integer(big_integer const& a) {
+    size_t n = a.limb_count() < LIMBS ? a.limb_count() : LIMBS;
+    for (size_t i = 0; i < n; i++) {
+      limbs[i] = a.limb_data()[i];
+    }
+    normalize();
+    if (a.is_negative()) {
+      *this = -*this;
+    }
+  }
+
+  explicit operator big_integer() const {
+    bool neg = negative();
+    // the magnitude of the smallest signed value keeps its pattern
+    fixed_big_integer mag = neg ? -*this : *this;
+    return big_integer(mag.limbs, mag.limbs + LIMBS, neg);
+  }
+
+  constexpr bool negative() const {
+    return Signed && ((limbs[LIMBS - 1] >> TOP_BIT) & 1) != 0;
+  }
+
+  constexpr fixed_big_integer& operator+=(fixed_big_integer const& rhs) {
+    limb_t carry = 0;
+    for (size_t i = 0; i < LIMBS; i++) {
+      limb_t sum = limbs[i] + carry;
+      carry = sum < carry ? 1 : 0;
+      limbs[i] = sum + rhs.limbs[i];
+      carry += limbs[i] < sum ? 1 : 0;
+    }
+    return normalize();
+  }
+
+  constexpr fixed_big_integer& operator-=(fixed_big_integer const& rhs) {
+    limb_t borrow = 0;
+    for (size_t i = 0; i < LIMBS; i++) {
+      limb_t cur = limbs[i];
+      limb_t diff = cur - rhs.limbs[i];
+      limb_t next_borrow = cur < rhs.limbs[i] ? 1 : 0;
+      next_borrow += diff < borrow ? 1 : 0;
+      limbs[i] = diff - borrow;
+      borrow = next_borrow;
+    }
+    return normalize();
+  }
+
+  // only the limbs below Bits are computed
+  constexpr fixed_big_integer& operator*=(fixed_big_integer const& rhs) {
+    limb_t res[LIMBS]{};
+    for (size_t i = 0; i < LIMBS; i++) {
+      double_limb_t carry = 0;
+      for (size_t j = 0; i + j < LIMBS; j++) {
+        double_limb_t cur =
+            static_cast<double_limb_t>(limbs[i]) * rhs.limbs[j] + res[i + j] +
+            carry;
+        res[i + j] = static_cast<limb_t>(cur);
+        carry = cur >> LIMB_BITS;
+      }
+    }
+    for (size_t i = 0; i < LIMBS; i++) {
+      limbs[i] = res[i];
+    }
+    return normalize();
+  }
+
+  constexpr fixed_big_integer& operator/=(fixed_big_integer const& rhs) {
+    fixed_big_integer rem;
+    divmod(*this, rhs, *this, rem);
+    return *this;
+  }
+
+  constexpr fixed_big_integer& operator%=(fixed_big_integer const& rhs) {
+    fixed_big_integer quot;
+    divmod(*this, rhs, quot, *this);
+    return *this;
+  }
+
+  constexpr fixed_big_integer& operator&=(fixed_big_integer const& rhs) {
+    for (size_t i = 0; i < LIMBS; i++) {
+      limbs[i] &= rhs.limbs[i];
+    }
+    return *this;
+  }
+
+  constexpr fixed_big_integer& operator|=(fixed_big_integer const& rhs) {
+    for (size_t i = 0; i < LIMBS; i++) {
+      limbs[i] |= rhs.limbs[i];
+    }
+    return *this;
+  }
+
+  constexpr fixed_big_integer& operator^=(fixed_big_integer const& rhs) {
+    for (size_t i = 0; i < LIMBS; i++) {
+      limbs[i] ^= rhs.limbs[i];
+    }
+    return *this;
+  }
+
+  constexpr fixed_big_integer& operator<<=(int rhs) {
+    size_t whole = static_cast<size_t>(rhs) / LIMB_BITS;
+    int part = rhs % LIMB_BITS;
+    for (size_t i = LIMBS; i-- > 0;) {
+      limb_t cur = i >= whole ? limbs[i - whole] << part : 0;
+      if (part != 0 && i >= whole + 1) {
+        cur |= limbs[i - whole - 1] >> (LIMB_BITS - part);
+      }
+      limbs[i] = cur;
+    }
+    return normalize();
+  }
+
+  // arithmetic for Signed, so negative values round toward -infinity
+  constexpr fixed_big_integer& operator>>=(int rhs) {
+    size_t whole = static_cast<size_t>(rhs) / LIMB_BITS;
+    int part = rhs % LIMB_BITS;
+    limb_t fill = negative() ? ~static_cast<limb_t>(0) : 0;
+    for (size_t i = 0; i < LIMBS; i++) {
+      limb_t cur = extended(i + whole, fill) >> part;
+      if (part != 0) {
+        cur |= extended(i + whole + 1, fill) << (LIMB_BITS - part);
+      }
+      limbs[i] = cur;
+    }
+    return normalize();
+  }
+
+  constexpr fixed_big_integer operator+() const {
+    return *this;
+  }
+
+  constexpr fixed_big_integer operator-() const {
+    fixed_big_integer res = ~*this;
+    return ++res;
+  }
+
+  constexpr fixed_big_integer operator~() const {
+    fixed_big_integer res;
+    for (size_t i = 0; i < LIMBS; i++) {
+      res.limbs[i] = ~limbs[i];
+    }
+    return res.normalize();
+  }
+
+  constexpr fixed_big_integer& operator++() {
+    return *this += 1;
+  }
+
+  constexpr fixed_big_integer operator++(int) {
+    fixed_big_integer res = *this;
+    ++*this;
+    return res;
+  }
+
+  constexpr fixed_big_integer& operator--() {
+    return *this -= 1;
+  }
+
+  constexpr fixed_big_integer operator--(int) {
+    fixed_big_integer res = *this;
+    --*this;
+    return res;
+  }
+
+  friend constexpr fixed_big_integer operator+(fixed_big_integer a,
+                                               fixed_big_integer const& b) {
+    return a += b;
+  }
+
+  friend constexpr fixed_big_integer operator-(fixed_big_integer a,
+                                               fixed_big_integer const& b) {
+    return a -= b;
+  }
+
+  friend constexpr fixed_big_integer operator*(fixed_big_integer a,
+                                               fixed_big_integer const& b) {
+    return a *= b;
+  }
+
+  friend constexpr fixed_big_integer operator/(fixed_big_integer a,
+                                               fixed_big_integer const& b) {
+    return a /= b;
+  }
+
+  friend constexpr fixed_big_integer operator%(fixed_big_integer a,
+                                               fixed_big_integer const& b) {
+    return a %= b;
+  }
+
+  friend constexpr fixed_big_integer operator&(fixed_big_integer a,
+                                               fixed_big_integer const& b) {
+    return a &= b;
+  }
+
+  friend constexpr fixed_big_integer operator|(fixed_big_integer a,
+                                               fixed_big_integer const& b) {
+    return a |= b;
+  }
+
+  friend constexpr fixed_big_integer operator^(fixed_big_integer a,
+                                               fixed_big_integer const& b) {
+    return a ^= b;
+  }
+
+  friend constexpr fixed_big_integer operator<<(fixed_big_integer a, int b) {
+    return a <<= b;
+  }
+
+  friend constexpr fixed_big_integer operator>>(fixed_big_integer a, int b) {
+    return a >>= b;
+  }
+
+  friend constexpr bool operator==(fixed_big_integer const& a,
+                                   fixed_big_integer const& b) {
+    for (size_t i = 0; i < LIMBS; i++) {
+      if (a.limbs[i] != b.limbs[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend constexpr bool operator!=(fixed_big_integer const& a,
+                                   fixed_big_integer const& b) {
+    return !(a == b);
+  }
+
+  // equal signs compare like the unsigned patterns
+  friend constexpr bool operator<(fixed_big_integer const& a,
+                                  fixed_big_integer const& b) {
+    if (a.negative() != b.negative()) {
+      return a.negative();
+    }
+    return less_unsigned(a, b);
+  }
+
+  friend constexpr bool operator>(fixed_big_integer const& a,
+                                  fixed_big_integer const& b) {
+    return b < a;
+  }
+
+  friend constexpr bool operator<=(fixed_big_integer const& a,
+                                   fixed_big_integer const& b) {
+    return !(b < a);
+  }
+
+  friend constexpr bool operator>=(fixed_big_integer const& a,
+                                   fixed_big_integer const& b) {
+    return !(a < b);
+  }
+
+  friend std::string to_string(fixed_big_integer const& a) {
+    return to_string(static_cast<big_integer>(a));
+  }
+
+  friend std::ostream& operator<<(std::ostream& s,
+                                  fixed_big_integer const& a) {
+    return s << static_cast<big_integer>(a);
+  }
+
+private:
+#if BIG_INTEGER_LIMB_BITS == 64
+  __extension__ typedef unsigned __int128 double_limb_t;
+#else
+  using double_limb_t = uint64_t;
+#endif
+  // position of the highest bit in the top limb
+  static constexpr int TOP_BIT = static_cast<int>((Bits - 1) % LIMB_BITS);
+
+  // bits above Bits in the top limb are always zero
+  limb_t limbs[LIMBS]{};
+
+  template <typename T>
+  static constexpr bool is_below_zero(T a) {
+    if constexpr (std::is_signed<T>::value) {
+      return a < 0;
+    } else {
+      return false;
+    }
+  }
+
+  constexpr fixed_big_integer& normalize() {
+    if constexpr (TOP_BIT + 1 < LIMB_BITS) {
+      limbs[LIMBS - 1] &= (static_cast<limb_t>(1) << (TOP_BIT + 1)) - 1;
+    }
+    return *this;
+  }
+
+  // limb i of the infinite two's complement expansion, whose sign limbs are
+  // fill
+  constexpr limb_t extended(size_t i, limb_t fill) const {
+    if (i >= LIMBS) {
+      return fill;
+    }
+    if constexpr (TOP_BIT + 1 < LIMB_BITS) {
+      if (i == LIMBS - 1) {
+        return limbs[i] | (fill << (TOP_BIT + 1));
+      }
+    }
+    return limbs[i];
+  }
+
+  static constexpr bool less_unsigned(fixed_big_integer const& a,
+                                      fixed_big_integer const& b) {
+    for (size_t i = LIMBS; i-- > 0;) {
+      if (a.limbs[i] != b.limbs[i]) {
+        return a.limbs[i] < b.limbs[i];
+      }
+    }
+    return false;
+  }
+
+  // quotient and remainder of the patterns read as unsigned numbers: by a
+  // single limb in one pass, otherwise bit by bit; q and r may be the
+  // variables a and b came from
+  static constexpr void divmod_unsigned(fixed_big_integer a,
+                                        fixed_big_integer b,
+                                        fixed_big_integer& q,
+                                        fixed_big_integer& r) {
+    bool single = true;
+    for (size_t i = 1; i < LIMBS; i++) {
+      single = single && b.limbs[i] == 0;
+    }
+    q = fixed_big_integer();
+    r = fixed_big_integer();
+    if (single) {
+      limb_t rem = 0;
+      for (size_t i = LIMBS; i-- > 0;) {
+        double_limb_t cur =
+            (static_cast<double_limb_t>(rem) << LIMB_BITS) | a.limbs[i];
+        q.limbs[i] = static_cast<limb_t>(cur / b.limbs[0]);
+        rem = static_cast<limb_t>(cur % b.limbs[0]);
+      }
+      r.limbs[0] = rem;
+      return;
+    }
+    for (size_t bit = Bits; bit-- > 0;) {
+      // r < b, a bit shifted out of r leaves it above b as well
+      bool carry = ((r.limbs[LIMBS - 1] >> TOP_BIT) & 1) != 0;
+      r <<= 1;
+      r.limbs[0] |= (a.limbs[bit / LIMB_BITS] >> (bit % LIMB_BITS)) & 1;
+      if (carry || !less_unsigned(r, b)) {
+        r -= b;
+        q.limbs[bit / LIMB_BITS] |= static_cast<limb_t>(1)
+                                    << (bit % LIMB_BITS);
+      }
+    }
+  }
+
+  static constexpr void divmod(fixed_big_integer const& a,
+                               fixed_big_integer const& b,
+                               fixed_big_integer& q, fixed_big_integer& r) {
+    if (b == fixed_big_integer()) {
+      throw std::invalid_argument("fixed_big_integer division by zero");
+    }
+    bool a_neg = a.negative();
+    bool b_neg = b.negative();
+    divmod_unsigned(a_neg ? -a : a, b_neg ? -b : b, q, r);
+    if (a_neg != b_neg) {
+      q = -q;
+    }
+    if (a_neg) {
+      r = -r;
+    }
+  }
+};
+
+using uint256_t = fixed_big_integer<256>;
+using int256_t = fixed_big_integer<256, true>;
+using uint512_t = fixed_big_integer<512>;
+using int512_t = fixed_big_integer<512, true>;
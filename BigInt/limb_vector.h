@@ -0,0 +1,208 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+// Contiguous storage for trivially copyable elements: up to SMALL_SIZE of
+// them live inline, the heap is used only once the vector grows beyond that.
+template <typename T, size_t SMALL_SIZE>
+struct limb_vector {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "limb_vector copies elements bytewise");
+  static_assert(SMALL_SIZE > 0, "limb_vector needs inline storage");
+
+  using iterator = T*;
+  using const_iterator = T const*;
+
+  limb_vector() {} // = default leaves the union without an active member
+
+  limb_vector(limb_vector const& other) {
+    assign(other.begin(), other.end());
+  }
+
+  limb_vector(limb_vector&& other) noexcept {
+    steal(other);
+  }
+
+  limb_vector& operator=(limb_vector const& other) {
+    if (this != &other) {
+      assign(other.begin(), other.end());
+    }
+    return *this;
+  }
+
+  limb_vector& operator=(limb_vector&& other) noexcept {
+    if (this != &other) {
+      release();
+      steal(other);
+    }
+    return *this;
+  }
+
+  ~limb_vector() {
+    release();
+  }
+
+  T& operator[](size_t i) {
+    return data()[i];
+  }
+
+  T const& operator[](size_t i) const {
+    return data()[i];
+  }
+
+  T* data() {
+    return small() ? static_arr : dynamic_arr;
+  }
+
+  T const* data() const {
+    return small() ? static_arr : dynamic_arr;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  T& back() {
+    return data()[size_ - 1];
+  }
+
+  T const& back() const {
+    return data()[size_ - 1];
+  }
+
+  iterator begin() {
+    return data();
+  }
+
+  iterator end() {
+    return data() + size_;
+  }
+
+  const_iterator begin() const {
+    return data();
+  }
+
+  const_iterator end() const {
+    return data() + size_;
+  }
+
+  void push_back(T e) {
+    if (size_ == capacity_) {
+      set_capacity(grown_capacity(size_ + 1));
+    }
+    data()[size_++] = e;
+  }
+
+  void pop_back() {
+    size_--;
+  }
+
+  void clear() {
+    size_ = 0;
+  }
+
+  void reserve(size_t new_cap) {
+    if (new_cap > capacity_) {
+      set_capacity(new_cap);
+    }
+  }
+
+  void resize(size_t new_size, T val = T()) {
+    if (new_size > capacity_) {
+      set_capacity(grown_capacity(new_size));
+    }
+    if (new_size > size_) {
+      std::fill(data() + size_, data() + new_size, val);
+    }
+    size_ = new_size;
+  }
+
+  void assign(T const* first, T const* last) {
+    size_t new_size = last - first;
+    if (new_size > capacity_) {
+      T* tmp = new T[new_size];
+      std::copy(first, last, tmp);
+      release();
+      dynamic_arr = tmp;
+      capacity_ = new_size;
+    } else {
+      std::copy(first, last, data());
+    }
+    size_ = new_size;
+  }
+
+  void swap(limb_vector& other) {
+    if (small() || other.small()) {
+      limb_vector tmp(std::move(other));
+      other = std::move(*this);
+      *this = std::move(tmp);
+    } else {
+      std::swap(dynamic_arr, other.dynamic_arr);
+      std::swap(capacity_, other.capacity_);
+      std::swap(size_, other.size_);
+    }
+  }
+
+  friend bool operator==(limb_vector const& a, limb_vector const& b) {
+    return a.size_ == b.size_ && std::equal(a.begin(), a.end(), b.begin());
+  }
+
+  friend bool operator!=(limb_vector const& a, limb_vector const& b) {
+    return !(a == b);
+  }
+
+private:
+  size_t size_{0};
+  size_t capacity_{SMALL_SIZE};
+
+  union {
+    T static_arr[SMALL_SIZE];
+    T* dynamic_arr;
+  };
+
+  // a heap buffer is always larger than the inline one
+  bool small() const {
+    return capacity_ == SMALL_SIZE;
+  }
+
+  size_t grown_capacity(size_t min_cap) const {
+    return std::max(min_cap, 2 * capacity_);
+  }
+
+  void set_capacity(size_t new_cap) {
+    T* tmp = new T[new_cap];
+    std::copy(begin(), end(), tmp);
+    release();
+    dynamic_arr = tmp;
+    capacity_ = new_cap;
+  }
+
+  void release() {
+    if (!small()) {
+      delete[] dynamic_arr;
+      capacity_ = SMALL_SIZE;
+    }
+  }
+
+  // other is left empty and inline
+  void steal(limb_vector& other) {
+    if (other.small()) {
+      std::copy(other.begin(), other.end(), static_arr);
+    } else {
+      dynamic_arr = other.dynamic_arr;
+      capacity_ = other.capacity_;
+      other.capacity_ = SMALL_SIZE;
+    }
+    size_ = other.size_;
+    other.size_ = 0;
+  }
+};
@@ -1,11 +1,60 @@
 #include "gtest/gtest.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
 #include <limits>
+#include <new>
+#include <sstream>
 #include <string>
 
 #include "big_integer.h"
+#include "fixed_big_integer.h"
+
+namespace {
+// workers of parallel multiplications allocate too
+std::atomic<size_t> allocations{0};
+
+// (10^n - 1) * (10^m - 1) written out digit by digit, m <= n
+std::string nines_product(size_t n, size_t m) {
+  return std::string(m - 1, '9') + "8" + std::string(n - m, '9') +
+         std::string(m - 1, '0') + "1";
+}
+
+big_integer pseudo_random(size_t limbs, uint32_t seed) {
+  big_integer res;
+  for (size_t i = 0; i < limbs; i++) {
+    seed = seed * 1103515245 + 12345;
+    res <<= 32;
+    res += big_integer(seed);
+  }
+  return res;
+}
+} // namespace
+
+// gcc pairs new and delete it inlines into callers and warns about malloc
+// memory freed by delete, the replacements stay out of line
+#if defined(__GNUC__)
+#define TEST_NOINLINE __attribute__((noinline))
+#else
+#define TEST_NOINLINE
+#endif
+
+TEST_NOINLINE void* operator new(size_t size) {
+  allocations++;
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+TEST_NOINLINE void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+TEST_NOINLINE void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
 
 TEST(correctness, two_plus_two) {
   EXPECT_EQ(big_integer(4), big_integer(2) + big_integer(2));
@@ -61,6 +110,18 @@ TEST(correctness, ctor_invalid_string) {
   EXPECT_THROW(big_integer("++5"), std::invalid_argument);
 }
 
+TEST(correctness, ctor_invalid_long_string) {
+  std::string digits(100000, '5');
+  for (char c : {'/', ':', 'x', ' ', '-', '\0'}) {
+    for (size_t pos : {size_t(1), size_t(12345), digits.size() - 1}) {
+      std::string str = digits;
+      str[pos] = c;
+      EXPECT_THROW(big_integer{str}, std::invalid_argument);
+    }
+  }
+  EXPECT_EQ(big_integer(digits), -big_integer("-" + digits));
+}
+
 TEST(correctness, assignment_operator) {
   big_integer a = 4;
   big_integer b = 7;
@@ -298,6 +359,104 @@ TEST(correctness, performance_division_3) {
   big_integer z = x / y;
 }
 
+TEST(correctness, division_long_subquadratic) {
+  for (size_t n : {50, 400, 3000}) {
+    big_integer a = pseudo_random(2 * n + 13, 4);
+    big_integer b = pseudo_random(n, 5);
+    big_integer r = pseudo_random(n - 1, 6);
+    big_integer x = a * b + r;
+    EXPECT_EQ(a, x / b);
+    EXPECT_EQ(r, x % b);
+    EXPECT_EQ(-a, -x / b);
+    EXPECT_EQ(-r, -x % b);
+    EXPECT_EQ(-a, x / -b);
+  }
+}
+
+TEST(correctness, division_thresholds) {
+  big_integer_thresholds saved = big_integer::thresholds;
+  big_integer a = pseudo_random(900, 7);
+  big_integer b = pseudo_random(130, 8);
+  big_integer c = -pseudo_random(40, 9);
+
+  big_integer::thresholds.newton_div = 1'000'000;
+  big_integer ab = a / b;
+  big_integer ac = a % c;
+
+  big_integer::thresholds.newton_div = 2;
+  EXPECT_EQ(ab, a / b);
+  EXPECT_EQ(ac, a % c);
+
+  big_integer::thresholds.newton_div = 32;
+  EXPECT_EQ(ab, a / b);
+  EXPECT_EQ(ac, a % c);
+
+  big_integer::thresholds = saved;
+  EXPECT_EQ(ab, a / b);
+  EXPECT_EQ(ac, a % c);
+}
+
+TEST(correctness, div_trial_quotient_corrections) {
+  big_integer a(std::string(36, '9'));
+  big_integer b("1" + std::string(36, '0'));
+  EXPECT_EQ(0, a / b);
+  EXPECT_EQ(a, a % b);
+
+  big_integer c("131544942218009550263344547774102241279");
+  big_integer d("14793422557902012415");
+  EXPECT_EQ(big_integer("8892123624748613631"), c / d);
+  EXPECT_EQ(big_integer("14793422557902012414"), c % d);
+}
+
+TEST(correctness, divisor_reuse) {
+  EXPECT_THROW(big_integer_divisor(0), std::invalid_argument);
+  for (size_t n : {1, 2, 5, 400}) {
+    big_integer d = pseudo_random(n, 10);
+    for (big_integer const& m : {d, -d}) {
+      big_integer_divisor div(m);
+      for (size_t k : {0, 1, 3, 900}) {
+        big_integer a = pseudo_random(k, 11 + k);
+        for (big_integer const& x : {a, -a, a + m}) {
+          big_integer q;
+          big_integer r;
+          div.divmod(x, q, r);
+          EXPECT_EQ(x / m, q);
+          EXPECT_EQ(x % m, r);
+          EXPECT_EQ(q, div.div(x));
+          EXPECT_EQ(r, div.mod(x));
+        }
+      }
+    }
+  }
+}
+
+TEST(correctness, divisor_allocations) {
+  big_integer_thresholds saved = big_integer::thresholds;
+  // the Knuth and the Barrett path, a divisor of one limb
+  for (size_t newton_div : {size_t(1'000'000), size_t(4)}) {
+    big_integer::thresholds.newton_div = newton_div;
+    for (size_t n : {1, 5, 40}) {
+      big_integer_divisor div(pseudo_random(n, 30));
+      big_integer a = -pseudo_random(3 * n, 31);
+      big_integer q;
+      big_integer r;
+      div.divmod(a, q, r);
+      size_t before = allocations;
+      for (int i = 0; i < 10; i++) {
+        div.divmod(a, q, r);
+      }
+      EXPECT_EQ(before, allocations) << n;
+      EXPECT_EQ(a / pseudo_random(n, 30), q);
+      EXPECT_EQ(a % pseudo_random(n, 30), r);
+      // the quotient may take the place of the dividend
+      div.divmod(a, a, r);
+      EXPECT_EQ(q, a);
+    }
+  }
+  big_integer::thresholds = saved;
+  big_integer::release_scratch();
+}
+
 TEST(correctness, division_signed) {
   big_integer x = 10;
   EXPECT_EQ(x / (-5), -2);
@@ -644,6 +803,57 @@ TEST(correctness, mul_long_pow2) {
   EXPECT_EQ(c, b * b);
 }
 
+TEST(correctness, mul_long_subquadratic) {
+  for (size_t n : {300, 1600, 5000, 30000}) {
+    big_integer a(std::string(n, '9'));
+    big_integer b(std::string(n / 2 + 7, '9'));
+    EXPECT_EQ(big_integer(nines_product(n, n / 2 + 7)), a * b);
+    EXPECT_EQ(big_integer(nines_product(n, n)), a * a);
+    EXPECT_EQ(big_integer(nines_product(n, n / 2 + 7)), -a * -b);
+  }
+}
+
+TEST(correctness, mul_long_thresholds) {
+  big_integer_thresholds saved = big_integer::thresholds;
+  big_integer a = pseudo_random(700, 1);
+  big_integer b = -pseudo_random(500, 2);
+  big_integer c = pseudo_random(90, 3);
+
+  big_integer::thresholds.karatsuba_mul = 1'000'000;
+  big_integer::thresholds.toom3_mul = 1'000'000;
+  big_integer ab = a * b;
+  big_integer ac = a * c;
+
+  big_integer::thresholds.karatsuba_mul = 4;
+  big_integer::thresholds.toom3_mul = 1'000'000;
+  EXPECT_EQ(ab, a * b);
+  EXPECT_EQ(ac, a * c);
+
+  big_integer::thresholds.toom3_mul = 8;
+  EXPECT_EQ(ab, a * b);
+  EXPECT_EQ(ac, a * c);
+
+  big_integer::thresholds.ntt_mul = 8;
+  EXPECT_EQ(ab, a * b);
+  EXPECT_EQ(ac, a * c);
+
+  big_integer::thresholds = saved;
+  EXPECT_EQ(ab, a * b);
+  EXPECT_EQ(ac, c * a);
+}
+
+TEST(correctness, limb_boundaries) {
+  big_integer a = (big_integer(1) << 64) - 1;
+  EXPECT_EQ(big_integer("340282366920938463426481119284349108225"), a * a);
+  EXPECT_EQ(big_integer("18446744073709551615"), a * a / a);
+  EXPECT_EQ(big_integer(0), a * a % a);
+  EXPECT_EQ(big_integer("79228162495817593519834398720"), (a << 32) & ~a);
+  EXPECT_EQ(big_integer("4294967295"), (a << 32) >> 64);
+  EXPECT_EQ(big_integer("-4294967296"), (-a << 32) >> 64);
+  EXPECT_EQ(big_integer(std::numeric_limits<uint64_t>::max()) + 1,
+            big_integer("18446744073709551616"));
+}
+
 TEST(correctness, div_long) {
   big_integer a("10000000000000000000000000000000000000000000000000000000000000"
                 "000000000000000000000000000000");
@@ -737,6 +947,22 @@ TEST(correctness, string_conv) {
   EXPECT_EQ("-2147483649", to_string(lim));
 }
 
+TEST(correctness, string_conv_long) {
+  big_integer_thresholds saved = big_integer::thresholds;
+  for (size_t threshold : {1, 2, 40}) {
+    big_integer::thresholds.radix_conversion = threshold;
+    for (size_t n : {8, 9, 10, 17, 18, 19, 1000, 20000}) {
+      std::string nines(n, '9');
+      std::string power = "1" + std::string(n, '0');
+      std::string mixed = "123456789" + std::string(n, '0') + "987654321";
+      EXPECT_EQ(nines, to_string(big_integer(nines)));
+      EXPECT_EQ(power, to_string(big_integer(power)));
+      EXPECT_EQ("-" + mixed, to_string(big_integer("-" + mixed)));
+    }
+  }
+  big_integer::thresholds = saved;
+}
+
 namespace {
 template <typename T>
 void test_converting_ctor(T value) {
@@ -801,3 +1027,861 @@ TEST(correctness, converting_ctor4) {
 
   EXPECT_EQ(to_string(bignum), std::to_string(num));
 }
+
+TEST(correctness, word_sized_no_allocations) {
+  big_integer a = std::numeric_limits<int64_t>::max();
+  big_integer b = -12345678901234;
+  big_integer c;
+  size_t before = allocations;
+  c = a + b;
+  c = a - b;
+  c = a * b;
+  c = b * 2;
+  c = a / b;
+  c = a % b;
+  c = (a & b) | (a ^ ~b);
+  c = (a << 10) >> 3;
+  c = -b;
+  ++c;
+  swap(a, c);
+  EXPECT_EQ(before, allocations);
+  EXPECT_EQ(big_integer(12345678901235), a);
+}
+
+TEST(correctness, inline_storage_spill) {
+  big_integer a = 1;
+  big_integer small = -7;
+  for (int i = 0; i < 300; i++) {
+    a <<= 1;
+    big_integer copy = a;
+    swap(copy, small);
+    swap(copy, small);
+    EXPECT_EQ(a, copy);
+    EXPECT_EQ(-7, small);
+  }
+  big_integer b = a;
+  swap(a, small);
+  EXPECT_EQ(-7, a);
+  EXPECT_EQ(b, small);
+  small >>= 299;
+  EXPECT_EQ(2, small);
+  small = b;
+  EXPECT_EQ(1, small >> 300);
+  a = b - b;
+  EXPECT_EQ(0, a);
+}
+
+TEST(correctness, move_ctor_and_assignment) {
+  big_integer a = pseudo_random(20, 4);
+  big_integer expected = a;
+  big_integer b = std::move(a);
+  EXPECT_EQ(expected, b);
+  EXPECT_EQ(0, a);
+  a = std::move(b);
+  EXPECT_EQ(expected, a);
+  EXPECT_EQ(0, b);
+  b = 5;
+  b = std::move(b);
+  EXPECT_EQ(5, b);
+}
+
+TEST(correctness, rvalue_operands) {
+  big_integer a = pseudo_random(12, 5);
+  big_integer b = -pseudo_random(9, 6);
+  EXPECT_EQ(a - b, a - big_integer(b));
+  EXPECT_EQ(b - a, big_integer(b) - big_integer(a));
+  EXPECT_EQ(a + b, a + big_integer(b));
+  EXPECT_EQ(a * b, a * big_integer(b));
+  EXPECT_EQ(a & b, a & big_integer(b));
+  EXPECT_EQ(a | b, a | big_integer(b));
+  EXPECT_EQ(a ^ b, a ^ big_integer(b));
+  EXPECT_EQ(0, a - big_integer(a));
+}
+
+TEST(correctness, expression_chain_allocations) {
+  big_integer a = pseudo_random(10, 7);
+  big_integer b = pseudo_random(10, 8);
+  big_integer c = pseudo_random(10, 9);
+  big_integer d = pseudo_random(10, 10);
+  big_integer e = pseudo_random(10, 11);
+  big_integer expected = a * b;
+  expected += c * d;
+  expected -= e;
+
+  size_t before = allocations;
+  big_integer res = a * b + c * d - e;
+  size_t after = allocations;
+  // one buffer per product, everything else reuses them
+  EXPECT_GE(before + 2, after);
+  EXPECT_EQ(expected, res);
+}
+
+TEST(correctness, steady_loop_allocations) {
+  // n counts 32-bit pieces
+  auto check = [](size_t n) {
+    big_integer x = pseudo_random(n, 14);
+    big_integer y = pseudo_random(n, 15);
+    big_integer m = pseudo_random(n, 16) + 1;
+    big_integer expected = x;
+    for (int i = 0; i < 10; i++) {
+      expected = expected * y % m;
+    }
+    // the first rounds size the storage of x and the scratch area
+    for (int i = 0; i < 2; i++) {
+      x *= y;
+      x %= m;
+      x.addmul(y, m);
+      x.submul(y, m);
+    }
+    size_t before = allocations;
+    for (int i = 2; i < 10; i++) {
+      x *= y;
+      x %= m;
+      x.addmul(y, m);
+      x.submul(y, m);
+    }
+    EXPECT_EQ(before, allocations) << n;
+    EXPECT_EQ(expected, x);
+    // nothing but the resulting string once the scratch area is sized
+    to_string(x);
+    before = allocations;
+    std::string str = to_string(x);
+    EXPECT_LE(allocations, before + 1);
+    EXPECT_EQ(expected, big_integer(str));
+  };
+  big_integer_thresholds saved = big_integer::thresholds;
+  size_t ratio = big_integer::LIMB_BITS / 32;
+  // without workers the parallel parts run inline, the dispatch to the pool
+  // allocates
+  big_integer::set_threads(1);
+  for (size_t n : {size_t(6), size_t(40), size_t(100),
+                   saved.toom3_mul * ratio + 10,
+                   saved.newton_div * ratio + 10}) {
+    check(n);
+  }
+  big_integer::thresholds.ntt_mul = 200;
+  check(300 * ratio);
+  big_integer::thresholds = saved;
+  big_integer::set_threads(0);
+  big_integer::release_scratch();
+}
+
+TEST(correctness, addmul_submul) {
+  for (size_t n : {1, 3, 40, 200}) {
+    big_integer a = pseudo_random(n, 12);
+    big_integer b = -pseudo_random(n / 2 + 1, 13);
+    for (big_integer acc : {big_integer(0), big_integer(-1), pseudo_random(5, 14),
+                            -pseudo_random(3 * n, 15)}) {
+      big_integer expected = acc + a * b;
+      EXPECT_EQ(expected, big_integer(acc).addmul(a, b));
+      EXPECT_EQ(expected, big_integer(acc).submul(-a, b));
+      EXPECT_EQ(acc - a * a, big_integer(acc).submul(a, a));
+      EXPECT_EQ(acc + b * 12345, big_integer(acc).addmul_1(b, 12345));
+      EXPECT_EQ(acc - a * 7, big_integer(acc).submul_1(a, 7));
+    }
+  }
+}
+
+TEST(correctness, addmul_aliasing) {
+  big_integer a = -pseudo_random(10, 16);
+  big_integer b = pseudo_random(4, 17);
+  big_integer expected = a + a * b;
+  EXPECT_EQ(expected, a.addmul(a, b));
+  expected = a - a * a;
+  EXPECT_EQ(expected, a.submul(a, a));
+  expected = a + a * 3;
+  EXPECT_EQ(expected, a.addmul_1(a, 3));
+}
+
+TEST(correctness, sqr_every_tier) {
+  big_integer_thresholds saved = big_integer::thresholds;
+  for (size_t n : {1, 2, 3, 7, 31, 100, 400}) {
+    big_integer a = -pseudo_random(n, 18);
+    big_integer copy = a;
+    big_integer expected = a * copy;
+    EXPECT_EQ(expected, a * a);
+    EXPECT_EQ(expected, sqr(a));
+    big_integer::thresholds.karatsuba_mul = 4;
+    EXPECT_EQ(expected, a * a);
+    big_integer::thresholds.toom3_mul = 8;
+    EXPECT_EQ(expected, a * a);
+    big_integer::thresholds.ntt_mul = 8;
+    EXPECT_EQ(expected, a * a);
+    a *= a;
+    EXPECT_EQ(expected, a);
+    big_integer::thresholds = saved;
+  }
+  EXPECT_EQ(big_integer(nines_product(30000, 30000)),
+            sqr(big_integer(std::string(30000, '9'))));
+}
+
+TEST(correctness, parallel_mul) {
+  big_integer a = pseudo_random(3000, 40);
+  big_integer b = -pseudo_random(2500, 41);
+  big_integer expected = a * b;
+  big_integer expected_sqr = sqr(a);
+
+  big_integer_thresholds saved = big_integer::thresholds;
+  big_integer::thresholds.parallel_mul = 200;
+  for (size_t threads : {1, 3, 8}) {
+    big_integer::set_threads(threads);
+    EXPECT_EQ(threads, big_integer::threads());
+    EXPECT_EQ(expected, a * b);
+    EXPECT_EQ(expected_sqr, sqr(a));
+    big_integer::thresholds.ntt_mul = 1000;
+    EXPECT_EQ(expected, a * b);
+    big_integer::thresholds.ntt_mul = saved.ntt_mul;
+  }
+  big_integer::set_threads(0);
+  big_integer::thresholds = saved;
+}
+
+TEST(correctness, negative_limb_edges) {
+  big_integer a = -(big_integer(1) << 192);
+  EXPECT_EQ(big_integer("6277101735386680763835789423207666416102355444464034512896"),
+            a & ((big_integer(1) << 192) + 5));
+  EXPECT_EQ(a + 7, a | 7);
+  EXPECT_EQ(big_integer("-6277101735386680763495507056286727952638980837032266301440"),
+            a ^ (big_integer(1) << 128));
+  EXPECT_EQ(-(big_integer(1) << 128), a >> 64);
+  EXPECT_EQ(-(big_integer(1) << 128) - 1, (a - 1) >> 64);
+  EXPECT_EQ(-1, big_integer(-1) >> 1000);
+  EXPECT_EQ(-(big_integer(1) << 64), (-(big_integer(1) << 128) + 1) >> 64);
+  EXPECT_EQ(0, a - a);
+  EXPECT_EQ(to_string(big_integer(0)), to_string(-(a - a)));
+  EXPECT_EQ(a, ~~a);
+  EXPECT_EQ(-a - 1, ~a);
+}
+
+TEST(correctness, powmod_small) {
+  EXPECT_EQ(445, powmod(4, 13, 497));
+  EXPECT_EQ(976371285, powmod(2, 100, 1000000007));
+  EXPECT_EQ(997, powmod(-3, 1001, 1000));
+  EXPECT_EQ(997, powmod(-3, 1001, -1000));
+  EXPECT_EQ(big_integer("2707128288486860373"),
+            powmod(123456789, 987654321, big_integer(1) << 64));
+  EXPECT_EQ(1, powmod(2, (big_integer(1) << 61) - 2, (big_integer(1) << 61) - 1));
+  EXPECT_EQ(1, powmod(5, 0, 7));
+  EXPECT_EQ(0, powmod(5, 0, 1));
+  EXPECT_EQ(0, powmod(0, 5, 7));
+  EXPECT_THROW(powmod(2, 3, 0), std::invalid_argument);
+  EXPECT_THROW(powmod(2, -1, 7), std::invalid_argument);
+  EXPECT_THROW(big_integer_montgomery(10), std::invalid_argument);
+}
+
+TEST(correctness, powmod_large) {
+  for (size_t n : {1, 2, 5, 16, 40}) {
+    big_integer mod = pseudo_random(n, 19) | 1;
+    big_integer base = -pseudo_random(n + 1, 20);
+    big_integer exp = pseudo_random(2, 21);
+    big_integer expected = 1;
+    big_integer cur = base % mod + mod;
+    for (big_integer e = exp; e != 0; e >>= 1) {
+      if ((e & 1) != 0) {
+        expected = expected * cur % mod;
+      }
+      cur = cur * cur % mod;
+    }
+    big_integer_montgomery ctx(mod);
+    EXPECT_EQ(expected, ctx.pow(base, exp));
+    EXPECT_EQ(expected, ctx.pow(base + 5 * mod, exp));
+    EXPECT_EQ(expected, powmod(base, exp, -mod));
+    EXPECT_EQ(expected * expected % mod, ctx.pow(base, 2 * exp));
+    // the even modulus takes the fallback path
+    EXPECT_EQ(expected, powmod(base, exp, 2 * mod) % mod);
+  }
+}
+
+TEST(correctness, montgomery_allocations) {
+  for (size_t n : {1, 4, 40}) {
+    big_integer mod = pseudo_random(n, 19) | 1;
+    big_integer base = -pseudo_random(n + 1, 20);
+    big_integer exp = pseudo_random(8, 21);
+    big_integer_montgomery ctx(mod);
+    big_integer x = ctx.to_montgomery(base);
+    big_integer y;
+    size_t before = 0;
+    for (int i = 0; i < 11; i++) {
+      // the first round sizes the scratch area
+      if (i == 1) {
+        before = allocations;
+      }
+      x = ctx.mul(x, x);
+      x = ctx.from_montgomery(ctx.to_montgomery(x));
+      y = ctx.pow(base, exp);
+    }
+    // past the first calls only the results take storage of their own, up
+    // to 128 bits not even those
+    EXPECT_GE(before + (n <= 4 ? 0 : 40), allocations) << n;
+    EXPECT_EQ(powmod(base, 1 << 11, mod), ctx.from_montgomery(x));
+    EXPECT_EQ(powmod(base, exp, mod), y);
+  }
+  big_integer::release_scratch();
+}
+
+TEST(correctness, gcd_small) {
+  EXPECT_EQ(6, gcd(12, 18));
+  EXPECT_EQ(6, gcd(-12, 18));
+  EXPECT_EQ(6, gcd(12, -18));
+  EXPECT_EQ(5, gcd(0, -5));
+  EXPECT_EQ(5, gcd(-5, 0));
+  EXPECT_EQ(0, gcd(0, 0));
+  EXPECT_EQ(1, gcd(big_integer("340282366920938463463374607431768211457"),
+                   big_integer("18446744073709551629")));
+  EXPECT_EQ(big_integer("18446744073709551616"),
+            gcd(big_integer(1) << 64, big_integer(3) << 100));
+
+  big_integer s;
+  big_integer t;
+  EXPECT_EQ(2, xgcd(240, 46, s, t));
+  EXPECT_EQ(14, s);
+  EXPECT_EQ(-73, t);
+  EXPECT_EQ(2, xgcd(-240, 46, s, t));
+  EXPECT_EQ(2, s * -240 + t * 46);
+  EXPECT_EQ(5, xgcd(0, -5, s, t));
+  EXPECT_EQ(0, s);
+  EXPECT_EQ(-1, t);
+
+  EXPECT_EQ(4, modinv(3, 11));
+  EXPECT_EQ(7, modinv(-3, 11));
+  EXPECT_EQ(4, modinv(3, -11));
+  EXPECT_EQ(0, modinv(5, 1));
+  EXPECT_THROW(modinv(4, 6), std::invalid_argument);
+  EXPECT_THROW(modinv(4, 0), std::invalid_argument);
+}
+
+TEST(correctness, gcd_large) {
+  // consecutive Fibonacci numbers take the longest chain of Euclid steps
+  big_integer f0 = 0;
+  big_integer f1 = 1;
+  for (int i = 0; i < 20000; i++) {
+    f0 += f1;
+    swap(f0, f1);
+  }
+  big_integer a = pseudo_random(120, 22);
+  big_integer b = pseudo_random(100, 23);
+  big_integer common = pseudo_random(30, 24) | 1;
+
+  big_integer_thresholds saved = big_integer::thresholds;
+  for (size_t threshold : {saved.half_gcd, size_t(8)}) {
+    big_integer::thresholds.half_gcd = threshold;
+    big_integer::thresholds.half_gcd_base =
+        std::min(threshold, saved.half_gcd_base);
+    EXPECT_EQ(1, gcd(f1, f0));
+    big_integer s;
+    big_integer t;
+    EXPECT_EQ(1, xgcd(f1, f0, s, t));
+    EXPECT_EQ(1, s * f1 + t * f0);
+    EXPECT_EQ(s, modinv(f1, f0));
+
+    big_integer g = gcd(a, b);
+    EXPECT_EQ(g * common, gcd(a * common, -b * common));
+    EXPECT_EQ(g * common, xgcd(-a * common, b * common, s, t));
+    EXPECT_EQ(g * common, s * -a * common + t * b * common);
+    EXPECT_LE(0, s);
+    EXPECT_GT(b / g, s);
+  }
+  big_integer::thresholds = saved;
+}
+
+TEST(correctness, isqrt_small) {
+  big_integer rem;
+  for (int i = 0; i < 1000; i++) {
+    big_integer root = isqrt(i, rem);
+    EXPECT_LE(root * root, i);
+    EXPECT_GT((root + 1) * (root + 1), i);
+    EXPECT_EQ(i - root * root, rem);
+  }
+  EXPECT_EQ(big_integer("4294967295"), isqrt(big_integer("18446744073709551615")));
+  EXPECT_EQ(big_integer("4294967296"), isqrt(big_integer("18446744073709551616")));
+  EXPECT_EQ(10, iroot(1000, 3));
+  EXPECT_EQ(9, iroot(999, 3, rem));
+  EXPECT_EQ(270, rem);
+  EXPECT_EQ(-9, iroot(-999, 3, rem));
+  EXPECT_EQ(-270, rem);
+  EXPECT_EQ(1, iroot(big_integer(1) << 63, 64));
+  EXPECT_EQ(2, iroot(big_integer(1) << 64, 64));
+  EXPECT_EQ(12345, iroot(12345, 1));
+  EXPECT_THROW(isqrt(-1), std::invalid_argument);
+  EXPECT_THROW(iroot(-16, 4), std::invalid_argument);
+  EXPECT_THROW(iroot(16, 0), std::invalid_argument);
+}
+
+TEST(correctness, iroot_large) {
+  big_integer a = pseudo_random(300, 25);
+  for (int k : {2, 3, 5, 17, 1000}) {
+    big_integer rem;
+    big_integer root = iroot(a, k, rem);
+    big_integer root_pow = 1;
+    big_integer next_pow = 1;
+    for (int i = 0; i < k; i++) {
+      root_pow *= root;
+      next_pow *= root + 1;
+    }
+    EXPECT_EQ(a - root_pow, rem);
+    EXPECT_LE(0, rem);
+    EXPECT_GT(next_pow, a);
+
+    // exact powers and their neighbours
+    EXPECT_EQ(root, iroot(root_pow, k));
+    EXPECT_EQ(root - 1, iroot(root_pow - 1, k));
+    EXPECT_EQ(root + 1, iroot(next_pow, k, rem));
+    EXPECT_EQ(0, rem);
+  }
+  big_integer b = big_integer(1) << 100000;
+  EXPECT_EQ(big_integer(1) << 50000, isqrt(b));
+  EXPECT_EQ((big_integer(1) << 50000) - 1, isqrt(b - 1));
+}
+
+TEST(correctness, is_probable_prime_small) {
+  std::vector<int> primes;
+  for (int i = -10; i < 3000; i++) {
+    bool prime = i >= 2;
+    for (int p : primes) {
+      if (i % p == 0) {
+        prime = false;
+      }
+    }
+    if (prime) {
+      primes.push_back(i);
+    }
+    EXPECT_EQ(prime, is_probable_prime(i));
+  }
+  EXPECT_EQ(big_integer(2), next_prime(-5));
+  EXPECT_EQ(big_integer(3), next_prime(2));
+  EXPECT_EQ(big_integer(65537), next_prime(65521));
+  EXPECT_EQ(big_integer("4294967311"), next_prime(big_integer("4294967291")));
+}
+
+TEST(correctness, is_probable_prime_large) {
+  // Mersenne primes, a square of a prime and strong pseudoprimes to base 2
+  // whose factors all exceed the trial division bound
+  EXPECT_TRUE(is_probable_prime((big_integer(1) << 127) - 1));
+  EXPECT_TRUE(is_probable_prime((big_integer(1) << 521) - 1, 5));
+  EXPECT_FALSE(is_probable_prime((big_integer(1) << 523) - 1));
+  EXPECT_FALSE(is_probable_prime(big_integer(4295098369)));
+  EXPECT_FALSE(is_probable_prime(big_integer("3825123056546413051")));
+  EXPECT_FALSE(is_probable_prime(big_integer("318665857834031151167461")));
+
+  big_integer p = next_prime(big_integer(1) << 200);
+  EXPECT_EQ((big_integer(1) << 200) + 235, p);
+  EXPECT_FALSE(is_probable_prime(p * p));
+  EXPECT_FALSE(is_probable_prime(p * next_prime(p)));
+  EXPECT_EQ(p, next_prime(p - 1));
+}
+
+TEST(correctness, product_tree) {
+  EXPECT_EQ(big_integer(1), product({}));
+  EXPECT_EQ(big_integer(0), product({5, 0, pseudo_random(100, 1)}));
+
+  std::vector<big_integer> factors;
+  big_integer expected = 1;
+  for (int i = 0; i < 200; i++) {
+    factors.push_back(pseudo_random(1 + i % 37 * 7, i));
+    if (i % 5 == 0) {
+      factors.back().negate();
+    }
+    expected *= factors.back();
+  }
+  EXPECT_EQ(expected, product(factors));
+
+  // a small threshold makes even this product fork
+  big_integer_thresholds saved = big_integer::thresholds;
+  big_integer::thresholds.parallel_product = 4;
+  big_integer::set_threads(4);
+  EXPECT_EQ(expected, product(factors));
+  big_integer::set_threads(0);
+  big_integer::thresholds = saved;
+}
+
+TEST(correctness, factorial_binomial) {
+  big_integer f = 1;
+  for (int n = 0; n <= 300; n++) {
+    if (n > 0) {
+      f *= n;
+    }
+    EXPECT_EQ(f, factorial(n));
+  }
+  big_integer row = 1;
+  for (int k = 0; k <= 300; k++) {
+    EXPECT_EQ(row, binomial(300, k));
+    row = row * (300 - k) / (k + 1);
+  }
+  EXPECT_EQ(big_integer(0), binomial(10, 11));
+  EXPECT_EQ(big_integer(0), binomial(10, -1));
+  EXPECT_EQ(factorial(5000), factorial(2500) * factorial(2500) *
+                                 binomial(5000, 2500));
+  EXPECT_THROW(factorial(-1), std::invalid_argument);
+}
+
+TEST(correctness, export_import_bytes) {
+  using bytes = std::vector<uint8_t>;
+  auto twos = sign_encoding::twos_complement;
+  auto mag = sign_encoding::magnitude;
+  EXPECT_EQ(bytes{0x00}, export_bytes(0, byte_order::big, twos));
+  EXPECT_EQ(bytes{0xff}, export_bytes(-1, byte_order::big, twos));
+  EXPECT_EQ(bytes{0x81}, export_bytes(-1, byte_order::big, mag));
+  EXPECT_EQ(bytes{0x80}, export_bytes(-128, byte_order::big, twos));
+  EXPECT_EQ((bytes{0x80, 0x80}), export_bytes(-128, byte_order::big, mag));
+  EXPECT_EQ((bytes{0x00, 0x80}), export_bytes(128, byte_order::big, twos));
+  EXPECT_EQ((bytes{0x80, 0x00}), export_bytes(128, byte_order::little, twos));
+  EXPECT_EQ((bytes{0x7f, 0xff}), export_bytes(-129, byte_order::little, twos));
+  // leading sign bytes are accepted
+  bytes padded{0xff, 0xff, 0xfe};
+  EXPECT_EQ(big_integer(-2),
+            import_bytes(padded.data(), padded.size(), byte_order::big, twos));
+  EXPECT_EQ(big_integer(0), import_bytes(nullptr, 0, byte_order::big, mag));
+
+  for (size_t n : {1, 2, 3, 7, 64}) {
+    big_integer a = pseudo_random(n, 17);
+    std::vector<big_integer> values{a, -a, a + 1, -a - 1, a >> 5,
+                                    big_integer(1) << (32 * n),
+                                    -(big_integer(1) << (32 * n))};
+    for (big_integer const& x : values) {
+      for (byte_order order : {byte_order::little, byte_order::big}) {
+        for (sign_encoding enc : {twos, mag}) {
+          bytes b = export_bytes(x, order, enc);
+          EXPECT_EQ(export_size(x, enc), b.size());
+          EXPECT_EQ(x, import_bytes(b.data(), b.size(), order, enc));
+        }
+      }
+    }
+  }
+}
+
+TEST(correctness, varint) {
+  using bytes = std::vector<uint8_t>;
+  bytes out;
+  for (int x : {0, -1, 1, 63, -64, 64}) {
+    write_varint(x, out);
+  }
+  EXPECT_EQ((bytes{0x00, 0x01, 0x02, 0x7e, 0x7f, 0x80, 0x01}), out);
+
+  std::vector<big_integer> values;
+  for (size_t n : {1, 2, 3, 9, 50}) {
+    values.push_back(pseudo_random(n, 18));
+    values.push_back(-pseudo_random(n, 19));
+    values.push_back(big_integer(1) << (32 * n));
+  }
+  out.clear();
+  for (big_integer const& x : values) {
+    write_varint(x, out);
+  }
+  uint8_t const* first = out.data();
+  for (big_integer const& x : values) {
+    EXPECT_EQ(x, read_varint(first, out.data() + out.size()));
+  }
+  EXPECT_EQ(out.data() + out.size(), first);
+
+  bytes truncated{0x80, 0x81};
+  first = truncated.data();
+  EXPECT_THROW(read_varint(first, truncated.data() + truncated.size()),
+               std::invalid_argument);
+}
+
+TEST(correctness, limb_view) {
+  big_integer a = -pseudo_random(20, 20);
+  std::vector<big_integer::limb_t> stored(a.limb_data(),
+                                          a.limb_data() + a.limb_count());
+  stored.push_back(0);
+  EXPECT_EQ(a, big_integer(stored.data(), stored.data() + stored.size(),
+                           a.is_negative()));
+  EXPECT_EQ(-a, big_integer(stored.data(), stored.data() + stored.size()));
+}
+
+TEST(correctness, radix_io) {
+  EXPECT_EQ("ff", to_string(255, 16));
+  EXPECT_EQ("-101", to_string(-5, 2));
+  EXPECT_EQ("0", to_string(0, 36));
+  EXPECT_EQ("zz", to_string(36 * 36 - 1, 36));
+  EXPECT_EQ("-1000000000000000000000000",
+            to_string(-(big_integer(1) << 72), 8));
+  EXPECT_EQ(big_integer(255), big_integer("FF", 16));
+  EXPECT_EQ(big_integer(-255), big_integer("-00fF", 16));
+  EXPECT_EQ(big_integer(1295), big_integer("zz", 36));
+  EXPECT_THROW(big_integer("12", 2), std::invalid_argument);
+  EXPECT_THROW(big_integer("g", 16), std::invalid_argument);
+  EXPECT_THROW(big_integer("1", 1), std::invalid_argument);
+  EXPECT_THROW(to_string(1, 37), std::invalid_argument);
+
+  // long values take the divide and conquer paths of the other bases
+  for (size_t n : {1, 5, 30, 200, 1500}) {
+    big_integer a = pseudo_random(n, 21);
+    if (n % 2 == 1) {
+      a.negate();
+    }
+    for (int base = 2; base <= 36; base++) {
+      std::string str = to_string(a, base);
+      EXPECT_EQ(a, big_integer(str, base));
+    }
+    EXPECT_EQ(to_string(a), to_string(a, 10));
+    // digits of base 16 and 7 peeled off one at a time
+    for (int base : {7, 16}) {
+      std::string expected;
+      big_integer x = a;
+      x.absolutify();
+      while (x != 0) {
+        expected += "0123456789abcdef"[std::stoi(to_string(x % base))];
+        x /= base;
+      }
+      if (a < 0) {
+        expected += '-';
+      }
+      std::reverse(expected.begin(), expected.end());
+      EXPECT_EQ(expected, to_string(a, base));
+    }
+  }
+}
+
+TEST(correctness, to_chars_from_chars) {
+  char buf[64];
+  auto res = big_integer(-1234).to_chars(buf, buf + sizeof(buf));
+  EXPECT_EQ(std::errc(), res.ec);
+  EXPECT_EQ("-1234", std::string(buf, res.ptr));
+  EXPECT_EQ(std::errc::value_too_large,
+            big_integer(-1234).to_chars(buf, buf + 3).ec);
+
+  big_integer value = 7;
+  std::string str = "-0x";
+  auto parsed = from_chars(str.data(), str.data() + str.size(), value, 16);
+  EXPECT_EQ(std::errc(), parsed.ec);
+  EXPECT_EQ(str.data() + 2, parsed.ptr);
+  EXPECT_EQ(big_integer(0), value);
+  str = "-x1";
+  value = 7;
+  parsed = from_chars(str.data(), str.data() + str.size(), value);
+  EXPECT_EQ(std::errc::invalid_argument, parsed.ec);
+  EXPECT_EQ(str.data(), parsed.ptr);
+  EXPECT_EQ(big_integer(7), value);
+  EXPECT_EQ(std::errc::invalid_argument,
+            from_chars(str.data(), str.data(), value).ec);
+
+  for (size_t n : {1, 3, 30, 300}) {
+    big_integer a = -pseudo_random(n, 22);
+    for (int base : {2, 10, 16, 36}) {
+      std::string expected = to_string(a, base);
+      EXPECT_LE(expected.size(), a.digits_needed(base));
+      EXPECT_GE(expected.size() + 1, a.digits_needed(base));
+      std::string out(a.digits_needed(base) + 5, '#');
+      auto written = a.to_chars(&out[0], &out[0] + out.size(), base);
+      EXPECT_EQ(expected, std::string(out.data(), written.ptr));
+      big_integer back;
+      auto read = from_chars(out.data(), written.ptr, back, base);
+      EXPECT_EQ(written.ptr, read.ptr);
+      EXPECT_EQ(a, back);
+    }
+  }
+  // powers of the base are the longest values of their bit length
+  for (int k = 1; k < 200; k++) {
+    big_integer p = 1;
+    for (int i = 0; i < k; i++) {
+      p *= 10;
+    }
+    EXPECT_LE(to_string(p).size(), p.digits_needed());
+    EXPECT_LE(to_string(p - 1).size(), (p - 1).digits_needed());
+  }
+
+  // past thresholds.radix_conversion limbs the split runs in scratch limbs
+  // too, with and without Barrett division by the powers
+  big_integer_thresholds saved = big_integer::thresholds;
+  size_t ratio = big_integer::LIMB_BITS / 32;
+  size_t long_size = big_integer::thresholds.radix_conversion * ratio * 4 + 7;
+  for (size_t newton_div : {saved.newton_div, size_t(4)}) {
+    big_integer::thresholds.newton_div = newton_div;
+    for (size_t n : {size_t(30), long_size}) {
+      big_integer a = pseudo_random(n, 23);
+      std::vector<char> out(a.digits_needed());
+      a.to_chars(out.data(), out.data() + out.size());
+      size_t before = allocations;
+      auto written = a.to_chars(out.data(), out.data() + out.size());
+      EXPECT_EQ(before, allocations) << n;
+      EXPECT_EQ(to_string(a), std::string(out.data(), written.ptr));
+      big_integer::release_scratch();
+    }
+  }
+  big_integer::thresholds = saved;
+}
+
+TEST(correctness, digits_needed) {
+  EXPECT_EQ(1u, big_integer(0).digits_needed());
+  EXPECT_EQ(2u, big_integer(8).digits_needed());
+  EXPECT_EQ(2u, big_integer(9).digits_needed());
+  EXPECT_EQ(3u, big_integer(99).digits_needed());
+  EXPECT_EQ(3u, big_integer(100).digits_needed());
+  EXPECT_EQ(3u, big_integer(-8).digits_needed());
+  EXPECT_EQ(4u, big_integer(8).digits_needed(2));
+  EXPECT_EQ(3u, big_integer(-255).digits_needed(36));
+
+  // the digits fit into a buffer of exactly their length
+  auto check = [](big_integer const& a, int base) {
+    std::string expected = to_string(a, base);
+    EXPECT_LE(expected.size(), a.digits_needed(base));
+    EXPECT_GE(expected.size() + 1, a.digits_needed(base));
+    std::string out(expected.size(), '#');
+    auto res = a.to_chars(&out[0], &out[0] + out.size(), base);
+    EXPECT_EQ(std::errc(), res.ec);
+    EXPECT_EQ(expected, out);
+    EXPECT_EQ(std::errc::value_too_large,
+              a.to_chars(&out[0], &out[0] + out.size() - 1, base).ec);
+  };
+  for (int base : {2, 3, 7, 10, 16, 36}) {
+    big_integer p = 1;
+    for (int k = 0; k < 300; k++) {
+      check(p, base);
+      check(p - 1, base);
+      check(-p, base);
+      p *= base;
+    }
+  }
+  for (int v : {8, 9, 99, 100, -8, -99, -100}) {
+    check(v, 10);
+  }
+  check(pseudo_random(300, 24), 10);
+
+  // a buffer one short of the estimate is checked in scratch limbs
+  for (big_integer const& a : {big_integer(999), pseudo_random(300, 24)}) {
+    std::string out(to_string(a).size(), '#');
+    a.to_chars(&out[0], &out[0] + out.size());
+    size_t before = allocations;
+    auto res = a.to_chars(&out[0], &out[0] + out.size());
+    EXPECT_EQ(before, allocations);
+    EXPECT_EQ(std::errc(), res.ec);
+    EXPECT_EQ(to_string(a), out);
+  }
+  big_integer::release_scratch();
+}
+
+TEST(correctness, stream_input) {
+  std::istringstream in("  -123 456x 0007\n-\n");
+  big_integer a;
+  in >> a;
+  EXPECT_EQ(big_integer(-123), a);
+  in >> a;
+  EXPECT_EQ(big_integer(456), a);
+  EXPECT_EQ('x', in.get());
+  in >> a;
+  EXPECT_EQ(big_integer(7), a);
+  in >> a;
+  EXPECT_TRUE(in.fail());
+  EXPECT_EQ(big_integer(7), a);
+
+  // long enough for several merged chunks and the stream buffer refills
+  for (size_t n : {1, 50, 700, 3000}) {
+    big_integer expected = pseudo_random(n, 24);
+    expected.negate();
+    std::string str = to_string(expected);
+    std::istringstream long_in(str);
+    long_in >> a;
+    EXPECT_TRUE(long_in.eof());
+    EXPECT_FALSE(long_in.fail());
+    EXPECT_EQ(expected, a);
+  }
+}
+
+TEST(correctness, chunked_parser) {
+  for (int base : {10, 16, 7}) {
+    for (size_t n : {1, 60, 900}) {
+      big_integer expected = pseudo_random(n, 25);
+      std::string str = to_string(expected, base);
+      for (size_t piece : {size_t(1), size_t(37), str.size()}) {
+        big_integer_parser parser(base);
+        for (size_t i = 0; i < str.size(); i += piece) {
+          size_t end = std::min(str.size(), i + piece);
+          EXPECT_EQ(str.data() + end,
+                    parser.feed(str.data() + i, str.data() + end));
+        }
+        EXPECT_EQ(expected, parser.finish());
+        EXPECT_FALSE(parser.has_digits());
+      }
+    }
+  }
+  big_integer_parser parser;
+  std::string str = "-12a";
+  EXPECT_EQ(str.data() + 3, parser.feed(str.data(), str.data() + 4));
+  EXPECT_EQ(big_integer(-12), parser.finish());
+  str = "-";
+  parser.feed(str.data(), str.data() + 1);
+  EXPECT_THROW(parser.finish(), std::invalid_argument);
+}
+
+namespace {
+// x modulo 2^bits, read as two's complement if is_signed
+big_integer wrap(big_integer const& x, size_t bits, bool is_signed) {
+  big_integer mod = big_integer(1) << static_cast<int>(bits);
+  big_integer res = x & (mod - 1);
+  if (is_signed && res >= mod / 2) {
+    res -= mod;
+  }
+  return res;
+}
+
+template <size_t Bits, bool Signed>
+void test_fixed_width() {
+  using fixed = fixed_big_integer<Bits, Signed>;
+  big_integer top = big_integer(1) << static_cast<int>(Bits - 1);
+  std::vector<big_integer> values{0, 1, -1, 2, 3, top, top - 1, -top,
+                                  big_integer(123456789)};
+  for (uint32_t seed = 0; seed < 12; seed++) {
+    big_integer x = pseudo_random(1 + (Bits + 31) / 32, 30 + seed);
+    values.push_back(seed % 2 == 0 ? x : -x);
+    values.push_back(pseudo_random(1 + seed % 3, 50 + seed));
+  }
+  for (big_integer const& x : values) {
+    fixed a(x);
+    big_integer ax = wrap(x, Bits, Signed);
+    EXPECT_EQ(ax, static_cast<big_integer>(a));
+    EXPECT_EQ(to_string(ax), to_string(a));
+    EXPECT_EQ(wrap(~ax, Bits, Signed), static_cast<big_integer>(~a));
+    EXPECT_EQ(wrap(-ax, Bits, Signed), static_cast<big_integer>(-a));
+    for (int shift : {0, 1, 31, 64, 65, static_cast<int>(Bits) - 1}) {
+      if (shift < 0 || static_cast<size_t>(shift) >= Bits) {
+        continue;
+      }
+      EXPECT_EQ(wrap(ax << shift, Bits, Signed),
+                static_cast<big_integer>(a << shift));
+      EXPECT_EQ(wrap(ax >> shift, Bits, Signed),
+                static_cast<big_integer>(a >> shift));
+    }
+    for (big_integer const& y : values) {
+      fixed b(y);
+      big_integer by = wrap(y, Bits, Signed);
+      EXPECT_EQ(wrap(ax + by, Bits, Signed), static_cast<big_integer>(a + b));
+      EXPECT_EQ(wrap(ax - by, Bits, Signed), static_cast<big_integer>(a - b));
+      EXPECT_EQ(wrap(ax * by, Bits, Signed), static_cast<big_integer>(a * b));
+      EXPECT_EQ(wrap(ax & by, Bits, Signed), static_cast<big_integer>(a & b));
+      EXPECT_EQ(wrap(ax | by, Bits, Signed), static_cast<big_integer>(a | b));
+      EXPECT_EQ(wrap(ax ^ by, Bits, Signed), static_cast<big_integer>(a ^ b));
+      EXPECT_EQ(ax < by, a < b);
+      EXPECT_EQ(ax == by, a == b);
+      if (by != 0) {
+        EXPECT_EQ(wrap(ax / by, Bits, Signed), static_cast<big_integer>(a / b));
+        EXPECT_EQ(wrap(ax % by, Bits, Signed), static_cast<big_integer>(a % b));
+      }
+    }
+  }
+  fixed a = 5;
+  a /= a;
+  EXPECT_EQ(fixed(1), a);
+  EXPECT_THROW(a / fixed(), std::invalid_argument);
+}
+} // namespace
+
+TEST(correctness, fixed_width) {
+  test_fixed_width<256, false>();
+  test_fixed_width<256, true>();
+  test_fixed_width<100, true>();
+  test_fixed_width<64, false>();
+  test_fixed_width<512, true>();
+  test_fixed_width<7, true>();
+}
+
+TEST(correctness, fixed_width_constexpr) {
+  constexpr uint256_t a = (uint256_t(1) << 200) - 1;
+  constexpr uint256_t b = a * a + 12345;
+  static_assert(b % 1000 == uint256_t(b) % 1000, "");
+  static_assert(uint256_t(-1) == ~uint256_t(), "");
+  static_assert(int256_t(-7) / 2 == -3 && int256_t(-7) >> 1 == -4, "");
+  static_assert((a >> 199) == 1 && (a + 1) / a == 1, "");
+  EXPECT_EQ((big_integer(1) << 200) - 1, static_cast<big_integer>(a));
+  EXPECT_EQ(int512_t(-1), int512_t(big_integer(-1)));
+}